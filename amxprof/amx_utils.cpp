@@ -39,6 +39,18 @@ static unsigned char *GetAmxDataPtr(AMX *amx) {
 
 namespace amxprof {
 
+NativeTableIndex GetNumNatives(AMX *amx) {
+  NativeTableIndex num_natives = 0;
+  amx_NumNatives(amx, &num_natives);
+  return num_natives;
+}
+
+PublicTableIndex GetNumPublics(AMX *amx) {
+  PublicTableIndex num_publics = 0;
+  amx_NumPublics(amx, &num_publics);
+  return num_publics;
+}
+
 Address GetNativeAddress(AMX *amx, NativeTableIndex index) {
   AMX_HEADER *amxhdr = GetAmxHeader(amx);
 
@@ -50,6 +62,15 @@ Address GetNativeAddress(AMX *amx, NativeTableIndex index) {
   return 0;
 }
 
+void SetNativeAddress(AMX *amx, NativeTableIndex index, Address address) {
+  AMX_HEADER *amxhdr = GetAmxHeader(amx);
+
+  if (index >= 0) {
+    AMX_FUNCSTUBNT *natives = reinterpret_cast<AMX_FUNCSTUBNT*>(amx->base + amxhdr->natives);
+    natives[index].address = static_cast<ucell>(address);
+  }
+}
+
 Address GetPublicAddress(AMX *amx, PublicTableIndex index) {
   AMX_HEADER *amxhdr = GetAmxHeader(amx);
 
@@ -65,13 +86,15 @@ Address GetPublicAddress(AMX *amx, PublicTableIndex index) {
   return 0;
 }
 
-const char *GetNativeName(AMX *amx, NativeTableIndex index) {
+Address GetCodeSize(AMX *amx) {
   AMX_HEADER *amxhdr = GetAmxHeader(amx);
+  return amxhdr->dat - amxhdr->cod;
+}
 
-  NativeTableIndex num_natives = 0;
-  amx_NumNatives(amx, &num_natives);
+const char *GetNativeName(AMX *amx, NativeTableIndex index) {
+  AMX_HEADER *amxhdr = GetAmxHeader(amx);
 
-  if (index >= 0 && index < num_natives) {
+  if (index >= 0 && index < GetNumNatives(amx)) {
     AMX_FUNCSTUBNT *natives = reinterpret_cast<AMX_FUNCSTUBNT*>(amx->base + amxhdr->natives);
     return reinterpret_cast<char*>(natives[index].nameofs + amx->base);
   }
@@ -86,10 +109,7 @@ const char *GetPublicName(AMX *amx, PublicTableIndex index) {
     return "main";
   }
 
-  PublicTableIndex num_publics = 0;
-  amx_NumPublics(amx, &num_publics);
-
-  if (index >= 0 && index < num_publics) {
+  if (index >= 0 && index < GetNumPublics(amx)) {
     AMX_FUNCSTUBNT *publics = reinterpret_cast<AMX_FUNCSTUBNT*>(amxhdr->publics + amx->base);
     return reinterpret_cast<char*>(publics[index].nameofs + amx->base);
   }
@@ -107,7 +127,9 @@ Address GetRetrunAddress(AMX *amx, Address frame) {
 
 Address GetCalleeAddress(AMX *amx, Address frame) {
   Address return_address = GetRetrunAddress(amx, frame);
-  if (return_address != 0) {
+  AMX_HEADER *amxhdr = GetAmxHeader(amx);
+  if (return_address >= static_cast<Address>(sizeof(cell))
+      && return_address <= amxhdr->dat - amxhdr->cod) {
     Address code_start = reinterpret_cast<Address>(GetAmxCodePtr(amx));
     Address target_address_offset = code_start + return_address - sizeof(cell);
     return *reinterpret_cast<cell*>(target_address_offset) - code_start;
@@ -115,4 +137,12 @@ Address GetCalleeAddress(AMX *amx, Address frame) {
   return 0;
 }
 
+Address GetCallerFrame(AMX *amx, Address frame) {
+  if (frame >= 0 && frame >= amx->stk && frame < amx->stp) {
+    unsigned char *data = GetAmxDataPtr(amx);
+    return *reinterpret_cast<cell*>(data + frame);
+  }
+  return 0;
+}
+
 } // naemspace amxprof
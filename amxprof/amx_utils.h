@@ -29,14 +29,22 @@
 
 namespace amxprof {
 
+NativeTableIndex GetNumNatives(AMX *amx);
+PublicTableIndex GetNumPublics(AMX *amx);
+
 Address GetNativeAddress(AMX *amx, NativeTableIndex index);
+void SetNativeAddress(AMX *amx, NativeTableIndex index, Address address);
 Address GetPublicAddress(AMX *amx, PublicTableIndex index);
 
+// Returns the size of the code section in bytes.
+Address GetCodeSize(AMX *amx);
+
 const char *GetNativeName(AMX *amx, NativeTableIndex index);
 const char *GetPublicName(AMX *amx, PublicTableIndex index);
 
 Address GetReturnAddress(AMX *amx, Address frame);
 Address GetCalleeAddress(AMX *amx, Address frame);
+Address GetCallerFrame(AMX *amx, Address frame);
 
 } // naemspace amxprof
 
@@ -22,70 +22,221 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cassert>
+#include <map>
+#include <new>
+#include <utility>
 #include "call_graph.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "statistics.h"
 
 namespace amxprof {
 
 namespace {
 
-class Deleter : public CallGraph::Visitor {
- public:
-  virtual void Visit(const CallGraphNode *node) {
-    delete node;
-  }
-};
+const std::size_t kNodeIndexInitialSize = 256;
 
 } // anonymous namespace
 
-bool CallGraph::CompareStats::operator()(const FunctionStatistics *lhs,
-                                         const FunctionStatistics *rhs) const {
-  return lhs->function()->address() < rhs->function()->address();
-}
-
-CallGraph::CallGraph(CallGraphNode *root)
- : root_(root),
-   sentinel_(new CallGraphNode(this, 0))
+CallGraph::CallGraph()
+ : root_(0),
+   sentinel_(0),
+   num_nodes_(0),
+   node_index_(kNodeIndexInitialSize)
 {
-  if (!root) {
-    root_ = sentinel_;
-  }
+  sentinel_ = AddNode(0, 0);
+  root_ = sentinel_;
 }
 
 CallGraph::~CallGraph() {
-  Deleter deleter;
-  Traverse(&deleter);
+  for (std::vector<CallGraphNode*>::const_iterator iterator = chunks_.begin();
+       iterator != chunks_.end(); ++iterator) {
+    ::operator delete(*iterator);
+  }
 }
 
 CallGraphNode *CallGraph::AddCallee(FunctionStatistics *stats) {
-  Nodes::iterator iterator = nodes_.find(stats);
-  if (iterator == nodes_.end()) {
-    CallGraphNode *node = new CallGraphNode(this, stats, root_);
-    nodes_.insert(std::make_pair(stats, node));
-    return root_->AddCallee(node);
+  std::size_t mask = node_index_.size() - 1;
+  for (std::size_t i = Hash(root_, stats) & mask; ; i = (i + 1) & mask) {
+    const NodeIndexEntry &entry = node_index_[i];
+    if (entry.caller == root_ && entry.stats == stats) {
+      return entry.node;
+    }
+    if (entry.node == 0) {
+      return AddNode(root_, stats);
+    }
+  }
+}
+
+CallGraphNode *CallGraph::GetNode(std::size_t index) const {
+  return chunks_[index / kChunkSize] + index % kChunkSize;
+}
+
+CallGraphNode *CallGraph::AddNode(CallGraphNode *caller,
+                                  FunctionStatistics *stats) {
+  std::size_t index = num_nodes_;
+  if (index / kChunkSize == chunks_.size()) {
+    void *chunk = ::operator new(sizeof(CallGraphNode) * kChunkSize);
+    chunks_.push_back(static_cast<CallGraphNode*>(chunk));
+  }
+
+  CallGraphNode *node = new(GetNode(index))
+    CallGraphNode(this, stats, caller, index);
+  num_nodes_++;
+
+  if (caller != 0) {
+    node->next_sibling_ = caller->first_callee_;
+    caller->first_callee_ = node;
+    // Keep the load factor under 1/2.
+    if (num_nodes_ * 2 > node_index_.size()) {
+      GrowNodeIndex();
+    }
+    InsertNodeIndex(node);
+  }
+
+  return node;
+}
+
+void CallGraph::InsertNodeIndex(CallGraphNode *node) {
+  std::size_t mask = node_index_.size() - 1;
+  std::size_t i = Hash(node->caller_, node->stats_) & mask;
+  while (node_index_[i].node != 0) {
+    i = (i + 1) & mask;
+  }
+  NodeIndexEntry &entry = node_index_[i];
+  entry.caller = node->caller_;
+  entry.stats = node->stats_;
+  entry.node = node;
+}
+
+void CallGraph::GrowNodeIndex() {
+  NodeIndex old_index(node_index_.size() * 2);
+  old_index.swap(node_index_);
+  for (NodeIndex::const_iterator iterator = old_index.begin();
+       iterator != old_index.end(); ++iterator) {
+    if (iterator->node != 0) {
+      InsertNodeIndex(iterator->node);
+    }
   }
-  return root_->AddCallee(iterator->second);
+}
+
+// static
+std::size_t CallGraph::Hash(const CallGraphNode *caller,
+                            const FunctionStatistics *stats) {
+  // Both are pointers to aligned objects whose low bits are always zero.
+  std::size_t hash = reinterpret_cast<std::size_t>(caller) >> 3;
+  hash = hash * 31 + (reinterpret_cast<std::size_t>(stats) >> 3);
+  return hash ^ (hash >> 11);
+}
+
+void CallGraph::CopyTo(CallGraph *graph, const Statistics *stats) const {
+  graph->Clear();
+
+  // Callers are always added before their callees, so each node's caller
+  // is already copied by the time the node itself is reached.
+  for (std::size_t i = 1; i < num_nodes_; i++) {
+    const CallGraphNode *node = GetNode(i);
+    FunctionStatistics *copy_stats =
+      stats->GetStatisticsById(node->stats()->id());
+    CallGraphNode *copy =
+      graph->AddNode(graph->GetNode(node->caller()->index_), copy_stats);
+    copy->num_calls_ = node->num_calls_;
+    copy->num_child_calls_ = node->num_child_calls_;
+    copy->num_descendant_calls_ = node->num_descendant_calls_;
+    copy->total_time_ = node->total_time_;
+    copy->child_time_ = node->child_time_;
+  }
+}
+
+void CallGraph::Clear() {
+  num_nodes_ = 0;
+  NodeIndex(node_index_.size()).swap(node_index_);
+  sentinel_ = AddNode(0, 0);
+  root_ = sentinel_;
 }
 
 void CallGraph::Traverse(Visitor *visitor) const {
-  visitor->Visit(sentinel_);
-  for (Nodes::const_iterator iterator = nodes_.begin();
-       iterator != nodes_.end(); ++iterator) {
-    visitor->Visit(iterator->second);
+  for (std::size_t i = 0; i < num_nodes_; i++) {
+    visitor->Visit(GetNode(i));
   }
 }
 
-CallGraphNode::CallGraphNode(CallGraph *graph, FunctionStatistics *stats, CallGraphNode *caller) 
+void CallGraph::GetEdges(std::vector<CallGraphEdge> &edges) const {
+  typedef std::map<std::pair<const FunctionStatistics*,
+                             const FunctionStatistics*>,
+                   std::size_t> EdgeIndex;
+  EdgeIndex edge_index;
+
+  for (std::size_t i = 1; i < num_nodes_; i++) {
+    const CallGraphNode *node = GetNode(i);
+    const FunctionStatistics *caller = node->caller()->stats();
+    const FunctionStatistics *callee = node->stats();
+
+    std::pair<EdgeIndex::iterator, bool> result = edge_index.insert(
+      std::make_pair(std::make_pair(caller, callee), edges.size()));
+    if (result.second) {
+      CallGraphEdge edge = {caller, callee, 0, 0, 0};
+      edges.push_back(edge);
+    }
+
+    CallGraphEdge &edge = edges[result.first->second];
+    edge.num_calls += node->num_calls();
+    edge.self_time += node->self_time();
+
+    bool is_nested = false;
+    for (const CallGraphNode *outer = node->caller();
+         outer->stats() != 0; outer = outer->caller()) {
+      if (outer->stats() == callee && outer->caller()->stats() == caller) {
+        is_nested = true;
+        break;
+      }
+    }
+    if (!is_nested) {
+      edge.total_time += node->total_time();
+    }
+  }
+}
+
+CallGraphNode::CallGraphNode(CallGraph *graph, FunctionStatistics *stats,
+                             CallGraphNode *caller, std::size_t index)
  : graph_(graph),
    stats_(stats),
-   caller_(caller)
+   caller_(caller),
+   first_callee_(0),
+   next_sibling_(0),
+   index_(index),
+   num_calls_(0),
+   num_child_calls_(0),
+   num_descendant_calls_(0),
+   total_time_(0),
+   child_time_(0)
 {
 }
 
-CallGraphNode *CallGraphNode::AddCallee(CallGraphNode *node) {
-  callees_.insert(node);
-  return node;
+Ticks CallGraphNode::GetAdjustedSelfTime(const Overhead &overhead) const {
+  Ticks time = self_time()
+             - num_calls_ * overhead.call_time
+             - num_child_calls_ * overhead.child_time;
+  return time > 0 ? time : 0;
+}
+
+Ticks CallGraphNode::GetAdjustedTotalTime(const Overhead &overhead) const {
+  Ticks time = total_time_
+             - num_calls_ * overhead.call_time
+             - num_descendant_calls_ * (overhead.call_time +
+                                        overhead.child_time);
+  return time > 0 ? time : 0;
+}
+
+void CallGraphNode::AddCall(Ticks total_time, long num_descendant_calls) {
+  num_calls_++;
+  num_descendant_calls_ += num_descendant_calls;
+  total_time_ += total_time;
+  if (caller_ != 0) {
+    caller_->num_child_calls_++;
+    caller_->child_time_ += total_time;
+  }
 }
 
 } // namespace amxprof
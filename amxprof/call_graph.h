@@ -25,15 +25,32 @@
 #ifndef AMXPROF_CALL_GRAPH_H
 #define AMXPROF_CALL_GRAPH_H
 
-#include <map>
-#include <set>
+#include <cstddef>
+#include <vector>
+#include "clock.h"
 #include "macros.h"
 
 namespace amxprof {
 
 class CallGraphNode;
 class FunctionStatistics;
+struct Overhead;
+class Statistics;
+
+// All calls of callee made directly from caller, i.e. an edge of the call
+// graph between functions rather than call paths.
+struct CallGraphEdge {
+  const FunctionStatistics *caller; // 0 for the server
+  const FunctionStatistics *callee;
+  long num_calls;
+  Ticks total_time;
+  Ticks self_time;
+};
 
+// CallGraph is a calling context tree: it has a node for every unique call
+// path rather than for every function, so calls of a function made from
+// different places are counted separately. The sentinel is the tree's root
+// and stands for the server, which makes the outermost calls.
 class CallGraph {
   friend class CallGraphNode;
 
@@ -43,65 +60,133 @@ class CallGraph {
     virtual void Visit(const CallGraphNode *node) = 0;
   };
 
-  class CompareStats {
-   public:
-     bool operator()(const FunctionStatistics *lhs,
-                     const FunctionStatistics *rhs) const;
-  };
-
-  typedef std::map<FunctionStatistics*, CallGraphNode*, CompareStats> Nodes;
-
-  CallGraph(CallGraphNode *root = 0);
+  CallGraph();
   ~CallGraph();
 
+  // The node of the innermost running call, or the sentinel if nothing is
+  // running.
   CallGraphNode *root() const { return root_; }
   void set_root(CallGraphNode *root) { root_ = root;}
 
   CallGraphNode *sentinel() const { return sentinel_; }
 
+  // Number of nodes including the sentinel.
+  std::size_t num_nodes() const { return num_nodes_; }
+
+  // Returns the node for a call of the function from root(), adding it if
+  // the function was not called from there before.
   CallGraphNode *AddCallee(FunctionStatistics *stats);
 
+  // Makes graph a copy of this graph whose nodes refer to the matching
+  // functions in stats, a copy of the statistics made by
+  // Statistics::CopyTo(). The copy's root is its sentinel.
+  void CopyTo(CallGraph *graph, const Statistics *stats) const;
+
+  // Visits all nodes in the order they were added, starting with the
+  // sentinel. A caller is always visited before its callees.
   void Traverse(Visitor *visitor) const;
 
+  // Merges the nodes into edges between functions, in the order they were
+  // first called. The total time of a recursive call is not added again
+  // to an edge that is already on its call path.
+  void GetEdges(std::vector<CallGraphEdge> &edges) const;
+
+ private:
+  // Nodes are allocated in chunks of this many and never freed one by one.
+  static const std::size_t kChunkSize = 1024;
+
+  struct NodeIndexEntry {
+    const CallGraphNode *caller;
+    const FunctionStatistics *stats;
+    CallGraphNode *node;
+  };
+
+  typedef std::vector<NodeIndexEntry> NodeIndex;
+
+  CallGraphNode *GetNode(std::size_t index) const;
+
+  // Drops all nodes but the sentinel. The memory is kept for reuse.
+  void Clear();
+
+  CallGraphNode *AddNode(CallGraphNode *caller, FunctionStatistics *stats);
+
+  void InsertNodeIndex(CallGraphNode *node);
+  void GrowNodeIndex();
+
+  static std::size_t Hash(const CallGraphNode *caller,
+                          const FunctionStatistics *stats);
+
  private:
   CallGraphNode *root_;
   CallGraphNode *sentinel_;
-  Nodes nodes_;
+
+  // All nodes in the order they were added, the sentinel comes first.
+  std::vector<CallGraphNode*> chunks_;
+  std::size_t num_nodes_;
+
+  // Open addressing hash table of nodes keyed by (caller, function). The
+  // key is stored along with the node so that probing doesn't have to
+  // touch the nodes themselves.
+  NodeIndex node_index_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(CallGraph);
 };
 
+// Nodes live in their graph's memory chunks and are never destroyed, so
+// they must not own any resources.
 class CallGraphNode {
- public:
-  typedef std::set<CallGraphNode*> Callees;
-
-  class CompareNodes {
-   public:
-     bool operator()(const CallGraphNode *lhs,
-                     const CallGraphNode *rhs) const {
-       return CallGraph::CompareStats()(lhs->stats(), rhs->stats());
-     }
-  };
-
-  CallGraphNode(CallGraph *graph, FunctionStatistics *stats,
-                CallGraphNode *caller = 0);
+  friend class CallGraph;
 
+ public:
   void MakeRoot() { graph_->set_root(this); }
 
   CallGraph *graph() const { return graph_; }
+
+  // Returns 0 for the sentinel.
   FunctionStatistics *stats() const { return stats_; }
 
   CallGraphNode *caller() const { return caller_; }
-  const Callees &callees() const { return callees_; }
 
-  CallGraphNode *AddCallee(CallGraphNode *node);
+  // The callees form a list, the most recently added callee comes first.
+  CallGraphNode *first_callee() const { return first_callee_; }
+  CallGraphNode *next_sibling() const { return next_sibling_; }
+
+  // These only count the calls made along this node's call path.
+  long num_calls() const { return num_calls_; }
+  long num_child_calls() const { return num_child_calls_; }
+  long num_descendant_calls() const { return num_descendant_calls_; }
+
+  Ticks total_time() const { return total_time_; }
+  Ticks child_time() const { return child_time_; }
+  Ticks self_time() const { return total_time_ - child_time_; }
+
+  // Same as self_time() and total_time() but with the profiler's overhead
+  // subtracted.
+  Ticks GetAdjustedSelfTime(const Overhead &overhead) const;
+  Ticks GetAdjustedTotalTime(const Overhead &overhead) const;
+
+  // Adds a finished call along this path that took total_time and made
+  // num_descendant_calls nested calls. Its time is also added to the
+  // caller's child time.
+  void AddCall(Ticks total_time, long num_descendant_calls);
+
+ private:
+  CallGraphNode(CallGraph *graph, FunctionStatistics *stats,
+                CallGraphNode *caller, std::size_t index);
 
  private:
   CallGraph *graph_;
   FunctionStatistics *stats_;
   CallGraphNode *caller_;
-  Callees callees_;
+  CallGraphNode *first_callee_;
+  CallGraphNode *next_sibling_;
+  std::size_t index_;
+  long num_calls_;
+  long num_child_calls_;
+  long num_descendant_calls_;
+  Ticks total_time_;
+  Ticks child_time_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(CallGraphNode);
@@ -0,0 +1,71 @@
+// Copyright (c) 2011-2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "call_graph.h"
+#include "call_graph_writer_collapsed.h"
+#include "duration.h"
+#include "function.h"
+#include "function_statistics.h"
+
+namespace amxprof {
+
+void CallGraphWriterCollapsed::Write(const CallGraph *graph) {
+  WritePath write_path(this);
+  graph->Traverse(&write_path);
+}
+
+void CallGraphWriterCollapsed::WritePath::Visit(const CallGraphNode *node) {
+  if (node == node->graph()->sentinel()) {
+    return;
+  }
+
+  double self_time = Clock::ToNanoseconds(node->self_time()).count();
+  if (self_time < 0.5) {
+    return;
+  }
+
+  std::vector<const CallGraphNode*> path;
+  for (; node->stats() != 0; node = node->caller()) {
+    path.push_back(node);
+  }
+
+  std::ostream *stream = writer_->stream();
+
+  for (std::vector<const CallGraphNode*>::reverse_iterator iterator =
+         path.rbegin();
+       iterator != path.rend(); ++iterator) {
+    if (iterator != path.rbegin()) {
+      *stream << ';';
+    }
+    *stream << (*iterator)->stats()->function()->name();
+  }
+
+  *stream << ' ' << static_cast<long long>(std::floor(self_time + 0.5))
+          << '\n';
+}
+
+} // namespace amxprof
@@ -0,0 +1,53 @@
+// Copyright (c) 2011-2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_CALL_GRAPH_WRITER_COLLAPSED_H
+#define AMXPROF_CALL_GRAPH_WRITER_COLLAPSED_H
+
+#include "call_graph_writer.h"
+
+namespace amxprof {
+
+class CallGraphNode;
+
+// Writes the call graph in the collapsed stack format read by
+// flamegraph.pl: one line per call path with the functions separated by
+// semicolons, followed by the path's self time in nanoseconds.
+class CallGraphWriterCollapsed : public CallGraphWriter {
+ public:
+  virtual void Write(const CallGraph *graph);
+
+ private:
+  class WritePath : public CallGraphWriter::Visitor {
+   public:
+    WritePath(CallGraphWriter *writer)
+     : CallGraphWriter::Visitor(writer)
+    {}
+    virtual void Visit(const CallGraphNode *node);
+  };
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_CALL_GRAPH_WRITER_COLLAPSED_H
@@ -25,10 +25,12 @@
 #ifndef AMXPROF_CALL_GRAPH_WRITER_H
 #define AMXPROF_CALL_GRAPH_WRITER_H
 
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include "call_graph.h"
 #include "call_graph_writer_dot.h"
+#include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
 
@@ -41,9 +43,10 @@ void CallGraphWriterDot::Write(const CallGraph *graph) {
     "  node [style=filled];\n"
     ;
 
-  WriteNode write_node(this);
-  graph->Traverse(&write_node);
-  
+  std::vector<CallGraphEdge> edges;
+  graph->GetEdges(edges);
+  WriteEdges(edges);
+
   ComputeMaxTime compute_max_time(this);
   graph->Traverse(&compute_max_time);
 
@@ -67,46 +70,66 @@ class ComputeMaxTime : public CallGraph::Visitor {
  public:
   virtual void Visit(const CallGraphNode *node);
  private:
-  Nanoseconds max_time_;
+  Ticks max_time_;
 };
 
-void CallGraphWriterDot::WriteNode::Visit(const CallGraphNode *node) {
-  if (node->callees().empty()) {
-    return;
-  }
-
-  std::string caller_name;
-  if (node->stats()) {
-    caller_name = node->stats()->function()->name();
-  } else {
-    caller_name = writer_->root_node_name();
+void CallGraphWriterDot::WriteEdges(const std::vector<CallGraphEdge> &edges) {
+  Ticks max_time = 0;
+  for (std::vector<CallGraphEdge>::const_iterator iterator = edges.begin();
+       iterator != edges.end(); ++iterator) {
+    if (iterator->total_time > max_time) {
+      max_time = iterator->total_time;
+    }
   }
 
-  std::ostream *stream = writer_->stream();
+  std::ostream::fmtflags flags = stream()->flags();
+  std::streamsize precision = stream()->precision();
 
-  for (CallGraphNode::Callees::const_iterator iterator = node->callees().begin();
-       iterator != node->callees().end(); ++iterator)
+  for (std::vector<CallGraphEdge>::const_iterator iterator = edges.begin();
+       iterator != edges.end(); ++iterator)
   {
-    const CallGraphNode *callee = *iterator;
+    const CallGraphEdge &edge = *iterator;
 
-    *stream << "  \"" << caller_name << "\" -> \""
-            << callee->stats()->function()->name() << "\" [color=\"";
+    *stream() << "  \"";
+    if (edge.caller != 0) {
+      *stream() << edge.caller->function()->name();
+    } else {
+      *stream() << root_node_name();
+    }
+    *stream() << "\" -> \"" << edge.callee->function()->name()
+              << "\" [color=\"";
 
-    Function::Type fn_type = callee->stats()->function()->type();
+    Function::Type fn_type = edge.callee->function()->type();
     switch (fn_type) {
       case Function::NORMAL:
-        *stream << "#777777";
+        *stream() << "#777777";
         break;
       case Function::PUBLIC:
-        *stream << "#4B4E99";
+        *stream() << "#4B4E99";
         break;
       case Function::NATIVE:
-        *stream << "#7C4B99";
+        *stream() << "#7C4B99";
         break;
     }
 
-    *stream << "\"];\n";
+    double ratio = 0.0;
+    if (max_time > 0) {
+      ratio = static_cast<double>(edge.total_time) /
+              static_cast<double>(max_time);
+    }
+
+    *stream() << std::fixed << std::setprecision(2)
+              << "\", penwidth=" << 1.0 + ratio * 4.0
+              << ", label=\"" << edge.num_calls << " calls\\n"
+              << std::setprecision(3)
+              << Milliseconds(Clock::ToNanoseconds(edge.total_time)).count()
+              << " ms\\n"
+              << Milliseconds(Clock::ToNanoseconds(edge.self_time)).count()
+              << " ms self\"];\n";
   }
+
+  stream()->flags(flags);
+  stream()->precision(precision);
 }
 
 void CallGraphWriterDot::WriteNodeColor::Visit(const CallGraphNode *node) {
@@ -117,9 +140,13 @@ void CallGraphWriterDot::WriteNodeColor::Visit(const CallGraphNode *node) {
     return;
   }
 
-  Nanoseconds time = node->stats()->self_time();
-  double ratio = static_cast<double>(time.count()) /
-                 static_cast<double>(max_time_.count());
+  if (!functions_.insert(node->stats()).second) {
+    return;
+  }
+
+  Ticks time = node->stats()->self_time();
+  double ratio = static_cast<double>(time) /
+                 static_cast<double>(max_time_);
 
   // We encode color in HSB.
   struct {
@@ -159,7 +186,7 @@ void CallGraphWriterDot::ComputeMaxTime::Visit(const CallGraphNode *node) {
     return;
   }
 
-  Nanoseconds time = node->stats()->self_time();
+  Ticks time = node->stats()->self_time();
   if (time > max_time_) {
     max_time_ = time;
   }
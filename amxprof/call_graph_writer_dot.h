@@ -25,46 +25,50 @@
 #ifndef AMXPROF_CALL_GRAPH_WRITER_DOT_H
 #define AMXPROF_CALL_GRAPH_WRITER_DOT_H
 
+#include <set>
+#include <vector>
+#include "call_graph.h"
 #include "call_graph_writer.h"
-#include "duration.h"
+#include "clock.h"
 
 namespace amxprof {
 
 class CallGraphNode;
+class FunctionStatistics;
 
+// Writes the call graph in the DOT language. Nodes of the calling context
+// tree that refer to the same function are merged into one. Edges are
+// labeled with the number of calls and their total time, and the more time
+// is spent in an edge the thicker it is.
 class CallGraphWriterDot : public CallGraphWriter {
  public:
   virtual void Write(const CallGraph *graph);
 
  private:
-  class WriteNode : public CallGraphWriter::Visitor {
-   public:
-    WriteNode(CallGraphWriter *writer)
-     : CallGraphWriter::Visitor(writer)
-    {}
-    virtual void Visit(const CallGraphNode *node);
-  };
+  void WriteEdges(const std::vector<CallGraphEdge> &edges);
 
   class WriteNodeColor : public CallGraphWriter::Visitor {
    public:
-    WriteNodeColor(CallGraphWriter *writer, Nanoseconds max_time)
+    WriteNodeColor(CallGraphWriter *writer, Ticks max_time)
      : CallGraphWriter::Visitor(writer),
        max_time_(max_time)
     {}
     virtual void Visit(const CallGraphNode *node);
    private:
-    Nanoseconds max_time_;
+    Ticks max_time_;
+    std::set<const FunctionStatistics*> functions_;
   };
 
   class ComputeMaxTime : public CallGraphWriter::Visitor {
    public:
     ComputeMaxTime(CallGraphWriter *writer)
-     : CallGraphWriter::Visitor(writer)
+     : CallGraphWriter::Visitor(writer),
+       max_time_(0)
     {}
     virtual void Visit(const CallGraphNode *node);
-    Nanoseconds max_time() const { return max_time_; }
+    Ticks max_time() const { return max_time_; }
    private:
-    Nanoseconds max_time_;
+    Ticks max_time_;
   };
 };
 
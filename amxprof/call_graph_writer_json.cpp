@@ -0,0 +1,79 @@
+// Copyright (c) 2011-2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <vector>
+#include "call_graph.h"
+#include "call_graph_writer_json.h"
+#include "clock.h"
+#include "duration.h"
+#include "function.h"
+#include "function_statistics.h"
+#include "json_utils.h"
+
+namespace amxprof {
+
+void CallGraphWriterJson::DoFunction(const FunctionStatistics *fn_stats) {
+  if (fn_stats != 0) {
+    StringView name = fn_stats->function()->name();
+    *stream() << "{\"type\": \"" << fn_stats->function()->GetTypeString()
+              << "\", \"name\": \"";
+    WriteJsonString(*stream(), name.data(), name.size());
+    *stream() << "\"}";
+  } else {
+    *stream() << "{\"type\": \"root\", \"name\": \""
+              << EscapeJsonString(root_node_name()) << "\"}";
+  }
+}
+
+void CallGraphWriterJson::Write(const CallGraph *graph) {
+  *stream() << "{\n"
+            << "  \"scriptName\": \"" << EscapeJsonString(script_name()) << "\",\n"
+            << "  \"edges\": [\n";
+
+  std::vector<CallGraphEdge> edges;
+  graph->GetEdges(edges);
+
+  for (std::vector<CallGraphEdge>::const_iterator iterator = edges.begin();
+       iterator != edges.end(); ++iterator)
+  {
+    const CallGraphEdge &edge = *iterator;
+
+    *stream() << "    {\n"
+      << "      \"caller\": ";
+    DoFunction(edge.caller);
+    *stream() << ",\n"
+      << "      \"callee\": ";
+    DoFunction(edge.callee);
+    *stream() << ",\n"
+      << "      \"calls\": " << edge.num_calls << ",\n"
+      << "      \"totalTime\": " << Clock::ToNanoseconds(edge.total_time).count() << ",\n"
+      << "      \"selfTime\": " << Clock::ToNanoseconds(edge.self_time).count() << "\n"
+      << "    }" << (iterator + 1 != edges.end() ? "," : "") << "\n";
+  }
+
+  *stream() << "  ]\n}\n";
+}
+
+} // namespace amxprof
@@ -22,26 +22,62 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cassert>
+#include <new>
 #include "call_stack.h"
+#include "exception.h"
 #include "function_call.h"
+#include "function_statistics.h"
 #include "performance_counter.h"
 
 namespace amxprof {
 
-void CallStack::Push(Function *function, Address frame) {
-  FunctionCall *parent = calls_.empty() ? 0 : &calls_.back();
-  Push(FunctionCall(function, frame, parent));
+CallStack::CallStack(std::size_t max_depth)
+ : calls_(max_depth, FunctionCall(0, 0)),
+   depth_(0)
+{
 }
 
-void CallStack::Push(const FunctionCall &call) {
-  calls_.push_back(call);
-  calls_.back().timer()->Start();
+void CallStack::Push(FunctionStatistics *fn_stats, Address frame) {
+  PushCall(fn_stats, frame)->timer()->Start();
 }
 
-FunctionCall CallStack::Pop() {
-  FunctionCall top = calls_.back();
-  calls_.pop_back();
-  top.timer()->Stop();
+void CallStack::Push(FunctionStatistics *fn_stats, Address frame,
+                     TimePoint time) {
+  PushCall(fn_stats, frame)->timer()->Start(time);
+}
+
+FunctionCall &CallStack::Pop() {
+  assert(depth_ > 0);
+  calls_[depth_ - 1].timer()->Stop();
+  return PopStoppedCall();
+}
+
+FunctionCall &CallStack::Pop(TimePoint time) {
+  assert(depth_ > 0);
+  calls_[depth_ - 1].timer()->Stop(time);
+  return PopStoppedCall();
+}
+
+FunctionCall *CallStack::PushCall(FunctionStatistics *fn_stats,
+                                  Address frame) {
+  if (depth_ == calls_.size()) {
+    throw Exception("Call stack overflow");
+  }
+  FunctionCall *parent = depth_ == 0 ? 0 : &calls_[depth_ - 1];
+  FunctionCall *call = new (&calls_[depth_]) FunctionCall(fn_stats, frame,
+                                                          parent);
+  depth_++;
+  fn_stats->set_active_call(call);
+  return call;
+}
+
+FunctionCall &CallStack::PopStoppedCall() {
+  FunctionCall &top = calls_[--depth_];
+  top.stats()->set_active_call(top.shadow());
+  if (top.parent() != 0) {
+    top.parent()->AddChildCall(top);
+  }
   return top;
 }
 
@@ -25,31 +25,59 @@
 #ifndef AMXPROF_CALL_STACK_H
 #define AMXPROF_CALL_STACK_H
 
-#include <list>
+#include <cstddef>
+#include <vector>
 #include "amx_types.h"
 #include "function_call.h"
+#include "macros.h"
 
 namespace amxprof {
 
-class Function;
+class FunctionStatistics;
 
+// CallStack keeps calls in a contiguous array that is allocated once at
+// construction, so pushing and popping calls never allocates memory. The
+// maximum depth can't be changed later as calls keep pointers to their
+// parents.
 class CallStack {
  public:
-  void Push(Function *function, Address frame);
-  void Push(const FunctionCall &call);
+  static const std::size_t kDefaultMaxDepth = 4096;
 
-  FunctionCall Pop();
+  explicit CallStack(std::size_t max_depth = kDefaultMaxDepth);
 
-  bool is_empty() const { return calls_.empty(); }
+  // Throws an Exception if the stack is full.
+  void Push(FunctionStatistics *fn_stats, Address frame);
 
-  FunctionCall *top() { return &calls_.back(); }
-  const FunctionCall *top() const { return &calls_.back(); }
+  // Returns the call that has just been removed from the stack. The
+  // returned reference remains valid until the next call to Push().
+  FunctionCall &Pop();
+
+  // Same as above but for calls that started or ended at the given time,
+  // e.g. replayed from recorded events.
+  void Push(FunctionStatistics *fn_stats, Address frame, TimePoint time);
+  FunctionCall &Pop(TimePoint time);
+
+  bool is_empty() const { return depth_ == 0; }
+
+  std::size_t depth() const { return depth_; }
+  std::size_t max_depth() const { return calls_.size(); }
+
+  FunctionCall *top() { return &calls_[depth_ - 1]; }
+  const FunctionCall *top() const { return &calls_[depth_ - 1]; }
+
+  FunctionCall *bottom() { return &calls_[0]; }
+  const FunctionCall *bottom() const { return &calls_[0]; }
+
+ private:
+  FunctionCall *PushCall(FunctionStatistics *fn_stats, Address frame);
+  FunctionCall &PopStoppedCall();
+
+ private:
+  std::vector<FunctionCall> calls_;
+  std::size_t depth_;
 
-  FunctionCall *bottom() { return &calls_.front(); }
-  const FunctionCall *bottom() const { return &calls_.front(); }
-  
  private:
-  std::list<FunctionCall> calls_;
+  DISALLOW_COPY_AND_ASSIGN(CallStack);
 };
 
 } // namespace amxprof
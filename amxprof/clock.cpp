@@ -0,0 +1,115 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#if defined _MSC_VER
+  #include <intrin.h>
+#elif defined __GNUC__
+  #include <cpuid.h>
+#endif
+#include "clock.h"
+
+namespace amxprof {
+
+namespace {
+
+// For how long the TSC is compared against the monotonic clock during
+// calibration.
+const Milliseconds kCalibrationTime = 50;
+
+} // anonymous namespace
+
+// static
+Clock::Source Clock::source_ = Clock::MONOTONIC;
+
+// static
+double Clock::ns_per_tick_ = Clock::GetMonotonicNsPerTick();
+
+// static
+bool Clock::SetSource(Source source) {
+  if (source == MONOTONIC) {
+    source_ = MONOTONIC;
+    ns_per_tick_ = GetMonotonicNsPerTick();
+    return true;
+  }
+
+  if (!HasInvariantTSC()) {
+    return false;
+  }
+
+  double ns_per_monotonic_tick = GetMonotonicNsPerTick();
+  Ticks calibration_ticks = static_cast<Ticks>(
+    Nanoseconds(kCalibrationTime).count() / ns_per_monotonic_tick);
+
+  Ticks monotonic_start = ReadMonotonic();
+  Ticks tsc_start = ReadTSC();
+  Ticks monotonic_end;
+  do {
+    monotonic_end = ReadMonotonic();
+  } while (monotonic_end - monotonic_start < calibration_ticks);
+  Ticks tsc_end = ReadTSC();
+
+  if (tsc_end <= tsc_start) {
+    return false;
+  }
+
+  source_ = TSC;
+  ns_per_tick_ = (monotonic_end - monotonic_start) * ns_per_monotonic_tick
+               / (tsc_end - tsc_start);
+  return true;
+}
+
+// static
+Ticks Clock::ReadTSC() {
+  #if defined _MSC_VER
+    return static_cast<Ticks>(__rdtsc());
+  #else
+    uint32_t low, high;
+    __asm__ __volatile__ ("rdtsc" : "=a"(low), "=d"(high));
+    return static_cast<Ticks>((static_cast<uint64_t>(high) << 32) | low);
+  #endif
+}
+
+// static
+bool Clock::HasInvariantTSC() {
+  // CPUID.80000007H:EDX[8] indicates that the TSC runs at a constant rate
+  // in all ACPI P-, C- and T-states.
+  unsigned int regs[4] = {0};
+  #if defined _MSC_VER
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (static_cast<unsigned int>(info[0]) < 0x80000007) {
+      return false;
+    }
+    __cpuid(info, 0x80000007);
+    regs[3] = info[3];
+  #else
+    if (__get_cpuid_max(0x80000000, 0) < 0x80000007) {
+      return false;
+    }
+    __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+  #endif
+  return (regs[3] & (1 << 8)) != 0;
+}
+
+} // namespace amxprof
@@ -25,31 +25,73 @@
 #ifndef AMXPROF_CLOCK_H
 #define AMXPROF_CLOCK_H
 
-#include <ctime>
 #include "duration.h"
+#include "stdint.h"
 
 namespace amxprof {
 
+// Raw clock ticks. The length of a tick depends on the current clock
+// source, use Clock::ToNanoseconds() to convert them to real time.
+typedef int64_t Ticks;
+
 class TimePoint {
  public:
-  TimePoint() : time_(0) {}
-  TimePoint(Nanoseconds time) : time_(time) {}
+  TimePoint() : ticks_(0) {}
+  explicit TimePoint(Ticks ticks) : ticks_(ticks) {}
 
-  Nanoseconds operator+(const TimePoint &other) const {
-    return Nanoseconds(time_ + other.time_);
-  }
+  Ticks ticks() const { return ticks_; }
 
-  Nanoseconds operator-(const TimePoint &other) const {
-    return Nanoseconds(time_ - other.time_);
+  Ticks operator-(const TimePoint &other) const {
+    return ticks_ - other.ticks_;
   }
 
  private:
-  Nanoseconds time_;
+  Ticks ticks_;
 };
 
 class Clock {
  public:
-  static TimePoint Now();
+  enum Source {
+    // The system's monotonic clock: clock_gettime(CLOCK_MONOTONIC) on
+    // POSIX and QueryPerformanceCounter() on Windows.
+    MONOTONIC,
+    // The CPU's time stamp counter read directly with RDTSC.
+    TSC
+  };
+
+  // Switches to another clock source. Switching to TSC calibrates it
+  // against the monotonic clock, which takes a few dozen milliseconds.
+  // Returns false and keeps the current source if the requested one is
+  // not reliable on this machine (i.e. the TSC is not invariant).
+  //
+  // This must be done before any time is measured because ticks of
+  // different sources can't be mixed.
+  static bool SetSource(Source source);
+  static Source source() { return source_; }
+
+  static TimePoint Now() {
+    return TimePoint(source_ == TSC ? ReadTSC() : ReadMonotonic());
+  }
+
+  static Nanoseconds ToNanoseconds(Ticks ticks) {
+    return Nanoseconds(static_cast<double>(ticks) * ns_per_tick_);
+  }
+
+  static Ticks FromNanoseconds(Nanoseconds ns) {
+    return static_cast<Ticks>(ns.count() / ns_per_tick_);
+  }
+
+ private:
+  // These are implemented separately for each platform.
+  static Ticks ReadMonotonic();
+  static double GetMonotonicNsPerTick();
+
+  static Ticks ReadTSC();
+  static bool HasInvariantTSC();
+
+ private:
+  static Source source_;
+  static double ns_per_tick_;
 };
 
 } // namespace amxprof
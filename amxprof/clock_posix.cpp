@@ -30,15 +30,19 @@
 namespace amxprof {
 
 // static
-TimePoint Clock::Now() {
+Ticks Clock::ReadMonotonic() {
   struct timespec ts;
 
   if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
     throw SystemError("clock_gettime");
   }
 
-  int64_t ns = static_cast<int64_t>(ts.tv_sec) * 1000000000L + ts.tv_nsec;
-  return Nanoseconds(ns);
+  return static_cast<Ticks>(ts.tv_sec) * 1000000000L + ts.tv_nsec;
+}
+
+// static
+double Clock::GetMonotonicNsPerTick() {
+  return 1.0;
 }
 
 } // namespace amxprof
@@ -30,20 +30,21 @@
 namespace amxprof {
 
 // static
-TimePoint Clock::Now() {
-  LARGE_INTEGER freq;
-  if (QueryPerformanceFrequency(&freq) == 0) {
-    throw SystemError("QueryPerformanceFrequency");
-  }
-
-  double ns_per_tick = 1E+9 / freq.QuadPart;
-
+Ticks Clock::ReadMonotonic() {
   LARGE_INTEGER count;
   if (QueryPerformanceCounter(&count) == 0) {
     throw SystemError("QueryPerformanceCounter");
   }
+  return count.QuadPart;
+}
 
-  return Nanoseconds(ns_per_tick * count.QuadPart);
+// static
+double Clock::GetMonotonicNsPerTick() {
+  LARGE_INTEGER freq;
+  if (QueryPerformanceFrequency(&freq) == 0) {
+    throw SystemError("QueryPerformanceFrequency");
+  }
+  return 1E+9 / freq.QuadPart;
 }
 
 } // namespace amxprof
@@ -0,0 +1,497 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstddef>
+#include <sstream>
+#include "code_patcher.h"
+#include "exception.h"
+
+namespace amxprof {
+
+namespace {
+
+enum Opcode {
+  OP_NONE,
+  OP_LOAD_PRI,
+  OP_LOAD_ALT,
+  OP_LOAD_S_PRI,
+  OP_LOAD_S_ALT,
+  OP_LREF_PRI,
+  OP_LREF_ALT,
+  OP_LREF_S_PRI,
+  OP_LREF_S_ALT,
+  OP_LOAD_I,
+  OP_LODB_I,
+  OP_CONST_PRI,
+  OP_CONST_ALT,
+  OP_ADDR_PRI,
+  OP_ADDR_ALT,
+  OP_STOR_PRI,
+  OP_STOR_ALT,
+  OP_STOR_S_PRI,
+  OP_STOR_S_ALT,
+  OP_SREF_PRI,
+  OP_SREF_ALT,
+  OP_SREF_S_PRI,
+  OP_SREF_S_ALT,
+  OP_STOR_I,
+  OP_STRB_I,
+  OP_LIDX,
+  OP_LIDX_B,
+  OP_IDXADDR,
+  OP_IDXADDR_B,
+  OP_ALIGN_PRI,
+  OP_ALIGN_ALT,
+  OP_LCTRL,
+  OP_SCTRL,
+  OP_MOVE_PRI,
+  OP_MOVE_ALT,
+  OP_XCHG,
+  OP_PUSH_PRI,
+  OP_PUSH_ALT,
+  OP_PUSH_R,
+  OP_PUSH_C,
+  OP_PUSH,
+  OP_PUSH_S,
+  OP_POP_PRI,
+  OP_POP_ALT,
+  OP_STACK,
+  OP_HEAP,
+  OP_PROC,
+  OP_RET,
+  OP_RETN,
+  OP_CALL,
+  OP_CALL_PRI,
+  OP_JUMP,
+  OP_JREL,
+  OP_JZER,
+  OP_JNZ,
+  OP_JEQ,
+  OP_JNEQ,
+  OP_JLESS,
+  OP_JLEQ,
+  OP_JGRTR,
+  OP_JGEQ,
+  OP_JSLESS,
+  OP_JSLEQ,
+  OP_JSGRTR,
+  OP_JSGEQ,
+  OP_SHL,
+  OP_SHR,
+  OP_SSHR,
+  OP_SHL_C_PRI,
+  OP_SHL_C_ALT,
+  OP_SHR_C_PRI,
+  OP_SHR_C_ALT,
+  OP_SMUL,
+  OP_SDIV,
+  OP_SDIV_ALT,
+  OP_UMUL,
+  OP_UDIV,
+  OP_UDIV_ALT,
+  OP_ADD,
+  OP_SUB,
+  OP_SUB_ALT,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_NOT,
+  OP_NEG,
+  OP_INVERT,
+  OP_ADD_C,
+  OP_SMUL_C,
+  OP_ZERO_PRI,
+  OP_ZERO_ALT,
+  OP_ZERO,
+  OP_ZERO_S,
+  OP_SIGN_PRI,
+  OP_SIGN_ALT,
+  OP_EQ,
+  OP_NEQ,
+  OP_LESS,
+  OP_LEQ,
+  OP_GRTR,
+  OP_GEQ,
+  OP_SLESS,
+  OP_SLEQ,
+  OP_SGRTR,
+  OP_SGEQ,
+  OP_EQ_C_PRI,
+  OP_EQ_C_ALT,
+  OP_INC_PRI,
+  OP_INC_ALT,
+  OP_INC,
+  OP_INC_S,
+  OP_INC_I,
+  OP_DEC_PRI,
+  OP_DEC_ALT,
+  OP_DEC,
+  OP_DEC_S,
+  OP_DEC_I,
+  OP_MOVS,
+  OP_CMPS,
+  OP_FILL,
+  OP_HALT,
+  OP_BOUNDS,
+  OP_SYSREQ_PRI,
+  OP_SYSREQ_C,
+  OP_FILE,
+  OP_LINE,
+  OP_SYMBOL,
+  OP_SRANGE,
+  OP_JUMP_PRI,
+  OP_SWITCH,
+  OP_CASETBL,
+  OP_SWAP_PRI,
+  OP_SWAP_ALT,
+  OP_PUSH_ADR,
+  OP_NOP,
+  OP_SYSREQ_D,
+  OP_SYMTAG,
+  OP_BREAK,
+  kNumOpcodes
+};
+
+// Number of operands of each instruction, -1 for the obsolete variable
+// length ones and CASETBL.
+const int kNumOperands[kNumOpcodes] = {
+  0, // NONE
+  1, // LOAD_PRI
+  1, // LOAD_ALT
+  1, // LOAD_S_PRI
+  1, // LOAD_S_ALT
+  1, // LREF_PRI
+  1, // LREF_ALT
+  1, // LREF_S_PRI
+  1, // LREF_S_ALT
+  0, // LOAD_I
+  1, // LODB_I
+  1, // CONST_PRI
+  1, // CONST_ALT
+  1, // ADDR_PRI
+  1, // ADDR_ALT
+  1, // STOR_PRI
+  1, // STOR_ALT
+  1, // STOR_S_PRI
+  1, // STOR_S_ALT
+  1, // SREF_PRI
+  1, // SREF_ALT
+  1, // SREF_S_PRI
+  1, // SREF_S_ALT
+  0, // STOR_I
+  1, // STRB_I
+  0, // LIDX
+  1, // LIDX_B
+  0, // IDXADDR
+  1, // IDXADDR_B
+  1, // ALIGN_PRI
+  1, // ALIGN_ALT
+  1, // LCTRL
+  1, // SCTRL
+  0, // MOVE_PRI
+  0, // MOVE_ALT
+  0, // XCHG
+  0, // PUSH_PRI
+  0, // PUSH_ALT
+  1, // PUSH_R
+  1, // PUSH_C
+  1, // PUSH
+  1, // PUSH_S
+  0, // POP_PRI
+  0, // POP_ALT
+  1, // STACK
+  1, // HEAP
+  0, // PROC
+  0, // RET
+  0, // RETN
+  1, // CALL
+  0, // CALL_PRI
+  1, // JUMP
+  1, // JREL
+  1, // JZER
+  1, // JNZ
+  1, // JEQ
+  1, // JNEQ
+  1, // JLESS
+  1, // JLEQ
+  1, // JGRTR
+  1, // JGEQ
+  1, // JSLESS
+  1, // JSLEQ
+  1, // JSGRTR
+  1, // JSGEQ
+  0, // SHL
+  0, // SHR
+  0, // SSHR
+  1, // SHL_C_PRI
+  1, // SHL_C_ALT
+  1, // SHR_C_PRI
+  1, // SHR_C_ALT
+  0, // SMUL
+  0, // SDIV
+  0, // SDIV_ALT
+  0, // UMUL
+  0, // UDIV
+  0, // UDIV_ALT
+  0, // ADD
+  0, // SUB
+  0, // SUB_ALT
+  0, // AND
+  0, // OR
+  0, // XOR
+  0, // NOT
+  0, // NEG
+  0, // INVERT
+  1, // ADD_C
+  1, // SMUL_C
+  0, // ZERO_PRI
+  0, // ZERO_ALT
+  1, // ZERO
+  1, // ZERO_S
+  0, // SIGN_PRI
+  0, // SIGN_ALT
+  0, // EQ
+  0, // NEQ
+  0, // LESS
+  0, // LEQ
+  0, // GRTR
+  0, // GEQ
+  0, // SLESS
+  0, // SLEQ
+  0, // SGRTR
+  0, // SGEQ
+  1, // EQ_C_PRI
+  1, // EQ_C_ALT
+  0, // INC_PRI
+  0, // INC_ALT
+  1, // INC
+  1, // INC_S
+  0, // INC_I
+  0, // DEC_PRI
+  0, // DEC_ALT
+  1, // DEC
+  1, // DEC_S
+  0, // DEC_I
+  1, // MOVS
+  1, // CMPS
+  1, // FILL
+  1, // HALT
+  1, // BOUNDS
+  0, // SYSREQ_PRI
+  1, // SYSREQ_C
+  -1, // FILE
+  -1, // LINE
+  -1, // SYMBOL
+  -1, // SRANGE
+  0, // JUMP_PRI
+  1, // SWITCH
+  -1, // CASETBL
+  0, // SWAP_PRI
+  0, // SWAP_ALT
+  1, // PUSH_ADR
+  0, // NOP
+  1, // SYSREQ_D
+  1, // SYMTAG
+  0, // BREAK
+};
+
+cell ReadCell(const unsigned char *code, Address address) {
+  return *reinterpret_cast<const cell*>(code + address);
+}
+
+void ThrowBadInstruction(const char *what, Address address) {
+  std::stringstream message;
+  message << what << " at address " << std::hex << address;
+  throw Exception(message.str());
+}
+
+} // anonymous namespace
+
+CodePatcher::CodePatcher(AMX *amx)
+ : amx_(amx),
+   code_(0),
+   code_size_(0),
+   nop_(OP_NOP),
+   num_breaks_(0)
+{
+  if ((amx->flags & AMX_FLAG_JITC) != 0) {
+    throw Exception("JIT-compiled code can't be patched");
+  }
+
+  AMX_HEADER *hdr = reinterpret_cast<AMX_HEADER*>(amx->base);
+  code_ = amx->base + hdr->cod;
+  code_size_ = hdr->dat - hdr->cod;
+
+  LoadOpcodeTable();
+  Decode();
+}
+
+void CodePatcher::LoadOpcodeTable() {
+  // Initialized AMX code normally stores addresses of the opcode handlers
+  // in amx_Exec() instead of opcode numbers. amx_Exec() reports the table
+  // of handlers when called in browsing mode.
+  cell *opcode_table = 0;
+  amx_->flags |= AMX_FLAG_BROWSE;
+  int error = amx_Exec(amx_, reinterpret_cast<cell*>(&opcode_table), 0);
+  amx_->flags &= ~AMX_FLAG_BROWSE;
+
+  if (error == AMX_ERR_NONE && opcode_table != 0) {
+    for (int i = 0; i < kNumOpcodes; i++) {
+      opcode_map_[opcode_table[i]] = i;
+    }
+    nop_ = opcode_table[OP_NOP];
+  }
+}
+
+void CodePatcher::Decode() {
+  jump_targets_.assign(code_size_ / sizeof(cell) + 1, false);
+
+  Address address = 0;
+  while (address < code_size_) {
+    Instruction instr;
+    instr.address = address;
+    instr.opcode = DecodeOpcode(ReadCell(code_, address));
+
+    if (instr.opcode < 0) {
+      ThrowBadInstruction("Unknown opcode", address);
+    }
+
+    int num_operands = kNumOperands[instr.opcode];
+
+    switch (instr.opcode) {
+      case OP_JUMP:
+      case OP_JZER:
+      case OP_JNZ:
+      case OP_JEQ:
+      case OP_JNEQ:
+      case OP_JLESS:
+      case OP_JLEQ:
+      case OP_JGRTR:
+      case OP_JGEQ:
+      case OP_JSLESS:
+      case OP_JSLEQ:
+      case OP_JSGRTR:
+      case OP_JSGEQ:
+        MarkJumpTarget(ReadCell(code_, address + sizeof(cell)));
+        break;
+      case OP_CASETBL: {
+        // CASETBL <number of cases> <default address> followed by pairs
+        // of <value> <address>.
+        cell num_cases = ReadCell(code_, address + sizeof(cell));
+        if (num_cases < 0) {
+          ThrowBadInstruction("Invalid case table", address);
+        }
+        num_operands = 2 + 2 * num_cases;
+        MarkJumpTarget(ReadCell(code_, address + 2 * sizeof(cell)));
+        for (cell i = 0; i < num_cases; i++) {
+          Address case_address = address + (4 + 2 * i) * sizeof(cell);
+          if (case_address >= code_size_) {
+            break;
+          }
+          MarkJumpTarget(ReadCell(code_, case_address));
+        }
+        break;
+      }
+      case OP_JUMP_PRI:
+        // #emit can jump to an address computed at run time, and the BREAK
+        // there may be needed.
+        ThrowBadInstruction("Computed jump", address);
+        break;
+      case OP_SCTRL:
+        if (ReadCell(code_, address + sizeof(cell)) == 6) { // CIP
+          ThrowBadInstruction("Computed jump", address);
+        }
+        break;
+      case OP_BREAK:
+        num_breaks_++;
+        break;
+    }
+
+    if (num_operands < 0) {
+      ThrowBadInstruction("Unsupported instruction", address);
+    }
+
+    instructions_.push_back(instr);
+    address += (1 + num_operands) * sizeof(cell);
+  }
+}
+
+int CodePatcher::RemoveRedundantBreaks() {
+  int num_removed = 0;
+  bool need_break = true;
+
+  for (std::vector<Instruction>::const_iterator iterator = instructions_.begin();
+       iterator != instructions_.end(); ++iterator) {
+    const Instruction &instr = *iterator;
+
+    if (jump_targets_[instr.address / sizeof(cell)]) {
+      need_break = true;
+    }
+
+    switch (instr.opcode) {
+      case OP_PROC:
+      case OP_CALL:
+      case OP_CALL_PRI:
+        need_break = true;
+        break;
+      case OP_BREAK:
+        if (need_break) {
+          need_break = false;
+        } else {
+          *reinterpret_cast<cell*>(code_ + instr.address) = nop_;
+          num_removed++;
+        }
+        break;
+    }
+  }
+
+  return num_removed;
+}
+
+int CodePatcher::DecodeOpcode(cell value) const {
+  if (opcode_map_.empty()) {
+    return (value >= 0 && value < kNumOpcodes) ? value : -1;
+  }
+  std::map<cell, int>::const_iterator iterator = opcode_map_.find(value);
+  if (iterator != opcode_map_.end()) {
+    return iterator->second;
+  }
+  return -1;
+}
+
+Address CodePatcher::DecodeAddress(cell value) const {
+  if ((amx_->flags & AMX_FLAG_RELOC) != 0) {
+    return value - reinterpret_cast<Address>(code_);
+  }
+  return value;
+}
+
+void CodePatcher::MarkJumpTarget(cell value) {
+  Address address = DecodeAddress(value);
+  if (address >= 0 && address < code_size_) {
+    jump_targets_[address / sizeof(cell)] = true;
+  }
+}
+
+} // namespace amxprof
@@ -0,0 +1,89 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_CODE_PATCHER_H
+#define AMXPROF_CODE_PATCHER_H
+
+#include <map>
+#include <vector>
+#include "amx_types.h"
+#include "macros.h"
+
+namespace amxprof {
+
+// CodePatcher rewrites instructions in the code section of a loaded AMX.
+// The AMX must be initialized, i.e. have its opcodes and jump addresses
+// relocated, and must not be JIT-compiled.
+class CodePatcher {
+ public:
+  // Throws an Exception if the code can't be decoded or if it contains
+  // jumps to computed addresses (JUMP_PRI, SCTRL 6), whose targets can't
+  // be known in advance.
+  explicit CodePatcher(AMX *amx);
+
+  // Replaces with NOPs the BREAK instructions that the profiler doesn't need
+  // for detecting function calls. Only these are kept:
+  //
+  //  * the first BREAK after PROC, i.e. at function entry;
+  //  * the first BREAK executed after a CALL returns, to see that the
+  //    callee has exited.
+  //
+  // The latter is found conservatively as the first BREAK following a CALL
+  // or a jump target. Returns the number of BREAKs that were removed.
+  int RemoveRedundantBreaks();
+
+  int num_breaks() const { return num_breaks_; }
+
+ private:
+  struct Instruction {
+    Address address;
+    int opcode;
+  };
+
+  void LoadOpcodeTable();
+  void Decode();
+
+  int DecodeOpcode(cell value) const;
+  Address DecodeAddress(cell value) const;
+  void MarkJumpTarget(cell value);
+
+ private:
+  AMX *amx_;
+  unsigned char *code_;
+  Address code_size_;
+  // Maps relocated opcodes back to opcode numbers. Empty if the opcodes
+  // are not relocated.
+  std::map<cell, int> opcode_map_;
+  cell nop_;
+  std::vector<Instruction> instructions_;
+  std::vector<bool> jump_targets_;
+  int num_breaks_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CodePatcher);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_CODE_PATCHER_H
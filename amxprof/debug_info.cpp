@@ -22,6 +22,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -29,6 +30,20 @@
 
 namespace amxprof {
 
+namespace {
+
+template<typename Entry>
+bool CompareEntries(const Entry &lhs, const Entry &rhs) {
+  return lhs.address < rhs.address;
+}
+
+template<typename Entry>
+bool CompareEntryToAddress(Address address, const Entry &entry) {
+  return address < entry.address;
+}
+
+} // anonymous namespace
+
 DebugInfo::DebugInfo()
  : amxdbg_(0),
    last_error_(AMX_ERR_NONE)
@@ -40,6 +55,7 @@ DebugInfo::DebugInfo(const AMX_DBG *amxdbg)
    last_error_(AMX_ERR_NONE)
 {
   std::memcpy(amxdbg_, amxdbg, sizeof(AMX_DBG));
+  BuildIndexes();
 }
 
 DebugInfo::DebugInfo(const std::string &filename)
@@ -56,6 +72,7 @@ void DebugInfo::Load(const std::string &filename) {
     last_error_ = dbg_LoadInfo(&amxdbg, fp);
     if (last_error_ == AMX_ERR_NONE) {
       amxdbg_ = new AMX_DBG(amxdbg);
+      BuildIndexes();
     }
     fclose(fp);
   }
@@ -65,43 +82,115 @@ void DebugInfo::Unload() {
   if (amxdbg_ != 0) {
     last_error_ = dbg_FreeInfo(amxdbg_);
     delete amxdbg_;
+    amxdbg_ = 0;
+  }
+  lines_.clear();
+  files_.clear();
+  functions_.clear();
+}
+
+void DebugInfo::BuildIndexes() {
+  const AMX_DBG_HDR *hdr = amxdbg_->hdr;
+
+  lines_.resize(hdr->lines);
+  for (int i = 0; i < hdr->lines; i++) {
+    lines_[i].address = amxdbg_->linetbl[i].address;
+    lines_[i].line = static_cast<long>(amxdbg_->linetbl[i].line);
+  }
+
+  files_.resize(hdr->files);
+  for (int i = 0; i < hdr->files; i++) {
+    files_[i].address = amxdbg_->filetbl[i]->address;
+    files_[i].name = amxdbg_->filetbl[i]->name;
   }
+
+  functions_.clear();
+  for (int i = 0; i < hdr->symbols; i++) {
+    const AMX_DBG_SYMBOL *symbol = amxdbg_->symboltbl[i];
+    // Names starting with '@' belong to compiler-generated functions that
+    // share the code of a real one.
+    if (symbol->ident == iFUNCTN && symbol->name[0] != '@') {
+      FunctionEntry entry;
+      entry.address = static_cast<Address>(symbol->codestart);
+      entry.end_address = static_cast<Address>(symbol->codeend);
+      entry.name = symbol->name;
+      functions_.push_back(entry);
+    }
+  }
+
+  // The compiler normally writes the tables in code order already. A stable
+  // sort keeps the symbol that comes first in the table in front in case
+  // two of them have the same address, as the dbg_Lookup* functions do.
+  std::stable_sort(lines_.begin(), lines_.end(), CompareEntries<LineEntry>);
+  std::stable_sort(files_.begin(), files_.end(), CompareEntries<FileEntry>);
+  std::stable_sort(functions_.begin(), functions_.end(),
+                   CompareEntries<FunctionEntry>);
+}
+
+// static
+template<typename Entry>
+const Entry *DebugInfo::FindEntry(const std::vector<Entry> &table,
+                                  Address address) {
+  typename std::vector<Entry>::const_iterator iterator =
+    std::upper_bound(table.begin(), table.end(), address,
+                     CompareEntryToAddress<Entry>);
+  if (iterator == table.begin()) {
+    return 0;
+  }
+  return &*--iterator;
 }
 
 long DebugInfo::LookupLine(Address address) const {
-  long line = 0;
-  last_error_ = dbg_LookupLine(amxdbg_, address, &line);
-  return line;
+  const LineEntry *entry = FindEntry(lines_, address);
+  if (entry == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+    return 0;
+  }
+  last_error_ = AMX_ERR_NONE;
+  return entry->line;
 }
 
 std::string DebugInfo::LookupFile(Address address) const {
-  std::string result;
-  const char *file;
-  last_error_ = dbg_LookupFile(amxdbg_, address, &file);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(file);
+  const FileEntry *entry = FindEntry(files_, address);
+  if (entry == 0) {
+    last_error_ = AMX_ERR_NOTFOUND;
+    return std::string();
   }
-  return result;
+  last_error_ = AMX_ERR_NONE;
+  return entry->name;
 }
 
 std::string DebugInfo::LookupFunction(Address address) const {
-  std::string result;
-  const char *function;
-  last_error_ = dbg_LookupFunction(amxdbg_, address, &function);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(function);
+  // Functions don't overlap, so only the closest one that starts at or
+  // before the address can contain it.
+  const FunctionEntry *entry = FindEntry(functions_, address);
+  if (entry != 0) {
+    // Several symbols may start at the same address, take the first one.
+    while (entry != &functions_[0] && (entry - 1)->address == entry->address) {
+      entry--;
+    }
+    if (address < entry->end_address) {
+      last_error_ = AMX_ERR_NONE;
+      return entry->name;
+    }
   }
-  return result;
+  last_error_ = AMX_ERR_NOTFOUND;
+  return std::string();
 }
 
 std::string DebugInfo::LookupFunctionExact(Address address) const {
-  std::string result;
-  const char *function;
-  last_error_ = dbg_LookupFunctionExact(amxdbg_, address, &function);
-  if (last_error_ == AMX_ERR_NONE) {
-    result.assign(function);
+  const FunctionEntry *entry = FindEntry(functions_, address);
+  if (entry != 0) {
+    while (entry != &functions_[0] && (entry - 1)->address == entry->address) {
+      entry--;
+    }
+    if (entry->address == address) {
+      last_error_ = AMX_ERR_NONE;
+      return entry->name;
+    }
   }
-  return result;
+  last_error_ = AMX_ERR_NOTFOUND;
+  return std::string();
 }
 
 bool HasDebugInfo(AMX *amx) {
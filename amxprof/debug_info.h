@@ -26,6 +26,7 @@
 #define AMXPROF_DEBUG_INFO_H
 
 #include <string>
+#include <vector>
 #include <amx/amx.h>
 #include <amx/amxdbg.h>
 #include "amx_types.h"
@@ -33,6 +34,9 @@
 
 namespace amxprof {
 
+// DebugInfo answers questions about the script's debug symbols. The
+// tables are indexed by address when the symbols are loaded, so every
+// lookup is a binary search rather than a scan of the whole table.
 class DebugInfo {
  public:
   DebugInfo();
@@ -44,6 +48,8 @@ class DebugInfo {
 
   bool is_loaded() const { return amxdbg_ != 0; }
 
+  // These return 0 or an empty string and set last_error() to
+  // AMX_ERR_NOTFOUND if nothing is found at the address.
   long LookupLine(Address address) const;
   std::string LookupFile(Address address) const;
   std::string LookupFunction(Address address) const;
@@ -51,9 +57,40 @@ class DebugInfo {
 
   int last_error() const { return last_error_; }
 
+ private:
+  // An entry of the line or file table, valid from its address up to the
+  // address of the next one.
+  struct LineEntry {
+    Address address;
+    long line;
+  };
+
+  struct FileEntry {
+    Address address;
+    const char *name;
+  };
+
+  // The code of a function spans [address, end_address).
+  struct FunctionEntry {
+    Address address;
+    Address end_address;
+    const char *name;
+  };
+
+  void BuildIndexes();
+
+  // Returns the last entry whose address is not above the given one, or
+  // 0 if there's no such entry. The table must be sorted by address.
+  template<typename Entry>
+  static const Entry *FindEntry(const std::vector<Entry> &table,
+                                Address address);
+
  private:
   AMX_DBG *amxdbg_;
   mutable int last_error_;
+  std::vector<LineEntry> lines_;
+  std::vector<FileEntry> files_;
+  std::vector<FunctionEntry> functions_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(DebugInfo);
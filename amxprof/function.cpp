@@ -32,7 +32,7 @@
 
 namespace amxprof {
 
-Function::Function(Type type, Address address, std::string name)
+Function::Function(Type type, Address address, StringView name)
  : type_(type),
    address_(address),
    name_(name)
@@ -40,30 +40,38 @@ Function::Function(Type type, Address address, std::string name)
 }
 
 // static
-Function *Function::Normal(Address address, DebugInfo *debug_info) {
+Function *Function::Normal(Address address) {
+  return new Function(NORMAL, address, StringView());
+}
+
+// static
+Function *Function::Public(AMX *amx, Address index, StringTable *names) {
+  return new Function(PUBLIC, GetPublicAddress(amx, index),
+                      names->Intern(GetPublicName(amx, index)));
+}
+
+// static
+Function *Function::Native(AMX *amx, Address index, StringTable *names) {
+  return new Function(NATIVE, GetNativeAddress(amx, index),
+                      names->Intern(GetNativeName(amx, index)));
+}
+
+void Function::ResolveName(StringTable *names, DebugInfo *debug_info) {
+  assert(type_ == NORMAL);
+
   std::string name;
 
-  if (address != 0 && debug_info != 0 && debug_info->is_loaded()) {
-    name = debug_info->LookupFunctionExact(address);
+  if (address_ != 0 && debug_info != 0 && debug_info->is_loaded()) {
+    name = debug_info->LookupFunctionExact(address_);
   }
 
   if (name.empty()) {
     std::stringstream ss;
-    ss << std::setw(8) << std::setfill('0') << std::hex << address;
+    ss << std::setw(8) << std::setfill('0') << std::hex << address_;
     name.append("unknown@").append(ss.str());
   }
 
-  return new Function(NORMAL, address, name);
-}
-
-// static
-Function *Function::Public(AMX *amx, Address index) {
-  return new Function(PUBLIC, GetPublicAddress(amx, index), GetPublicName(amx, index));
-}
-
-// static
-Function *Function::Native(AMX *amx, Address index) {
-  return new Function(NATIVE, GetNativeAddress(amx, index), GetNativeName(amx, index));
+  name_ = names->Intern(name);
 }
 
 const char *Function::GetTypeString() const {
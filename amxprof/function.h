@@ -25,8 +25,8 @@
 #ifndef AMXPROF_FUNCTION_FUNCTION_H
 #define AMXPROF_FUNCTION_FUNCTION_H
 
-#include <string>
 #include "amx_types.h"
+#include "string_table.h"
 
 namespace amxprof {
 
@@ -40,10 +40,15 @@ class Function {
     NATIVE  // native functions
   };
 
-  // Caller is reponsible for deleting returned Function objects.
-  static Function *Normal(Address address, DebugInfo *debug_info = 0);
-  static Function *Public(AMX *amx, PublicTableIndex index);
-  static Function *Native(AMX *amx, NativeTableIndex index);
+  // Caller is reponsible for deleting returned Function objects. Names
+  // are stored in the given table, which must outlive the functions.
+  // Normal functions are created without a name as looking it up is slow,
+  // see ResolveName().
+  static Function *Normal(Address address);
+  static Function *Public(AMX *amx, PublicTableIndex index,
+                          StringTable *names);
+  static Function *Native(AMX *amx, NativeTableIndex index,
+                          StringTable *names);
 
   // Returns the type of the function.
   Type type() const {
@@ -61,15 +66,18 @@ class Function {
   }
 
   // Returns the name of the function. Public and native functions
-  // always have a name. Ordinary functions' names are extract from
-  // debugging symbols provided at construction time; if there was
-  // no debug info provided or the function was not found among it
-  // the name is built from the string "unknown@" followed by the
-  // function address in hex.
-  std::string name() const {
+  // always have a name. Ordinary functions' names are empty until
+  // ResolveName() is called.
+  StringView name() const {
     return name_;
   }
 
+  // Gives a normal function its name. The name is extracted from the
+  // debugging symbols; if there is no debug info or the function was not
+  // found among it the name is built from the string "unknown@" followed
+  // by the function address in hex.
+  void ResolveName(StringTable *names, DebugInfo *debug_info = 0);
+
   // Comparison operators.
   bool operator==(const Function &other) const {
     return address_ == other.address_;
@@ -82,12 +90,12 @@ class Function {
   }
 
  private:
-  Function(Type type, Address address, std::string name);
+  Function(Type type, Address address, StringView name);
 
  private:
   Type type_;
   Address address_;
-  std::string name_;
+  StringView name_;
 };
 
 } // namespace amxprof
@@ -23,22 +23,27 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "function_call.h"
+#include "function_statistics.h"
 
 namespace amxprof {
 
-FunctionCall::FunctionCall(Function *function, Address frame, FunctionCall *parent)
- : fn_(function),
+FunctionCall::FunctionCall(FunctionStatistics *fn_stats, Address frame,
+                           FunctionCall *parent)
+ : fn_stats_(fn_stats),
    parent_(parent),
-   frame_(frame)
+   shadow_(0),
+   frame_(frame),
+   num_child_calls_(0),
+   num_descendant_calls_(0)
 {
-  FunctionCall *current = parent;
-
-  while (current != 0) {
-    if (current->fn_ == this->fn_) {
-      timer_.set_shadow(current->timer());
-      break;
-    }
-    current = current->parent_;
+  // The function's innermost active call is our closest recursive
+  // ancestor (if any), so there is no need to walk the parent chain.
+  if (fn_stats_ != 0 && parent_ != 0) {
+    shadow_ = fn_stats_->active_call();
+  }
+
+  if (shadow_ != 0) {
+    timer_.set_shadow(&shadow_->timer_);
   }
 
   if (parent_ != 0) {
@@ -46,4 +51,12 @@ FunctionCall::FunctionCall(Function *function, Address frame, FunctionCall *pare
   }
 }
 
+Function *FunctionCall::function() {
+  return fn_stats_->function();
+}
+
+const Function *FunctionCall::function() const {
+  return fn_stats_->function();
+}
+
 } // namespace amxprof
@@ -31,26 +31,50 @@
 namespace amxprof {
 
 class Function;
+class FunctionStatistics;
 
 class FunctionCall {
  public:
-  FunctionCall(Function *function, Address frame, FunctionCall *parent = 0);
+  FunctionCall(FunctionStatistics *fn_stats, Address frame,
+               FunctionCall *parent = 0);
 
-  Function *function() { return fn_; }
-  const Function *function() const { return fn_; }
+  Function *function();
+  const Function *function() const;
+
+  FunctionStatistics *stats() { return fn_stats_; }
+  const FunctionStatistics *stats() const { return fn_stats_; }
 
   FunctionCall *parent() { return parent_; }
   const FunctionCall *parent() const { return parent_; }
 
+  // Returns the closest outer call of the same function (i.e. this call
+  // is recursive), or 0 if there's none.
+  FunctionCall *shadow() { return shadow_; }
+  const FunctionCall *shadow() const { return shadow_; }
+
   Address frame() const { return frame_; }
 
+  // The number of calls made directly from this call and the number of
+  // all calls made while it was running (including nested ones).
+  long num_child_calls() const { return num_child_calls_; }
+  long num_descendant_calls() const { return num_descendant_calls_; }
+
+  // Called when a child call returns.
+  void AddChildCall(const FunctionCall &child) {
+    num_child_calls_++;
+    num_descendant_calls_ += child.num_descendant_calls_ + 1;
+  }
+
   PerformanceCounter *timer() { return &timer_; }
   const PerformanceCounter *timer() const { return &timer_; }
 
  private:
-  Function *fn_;
+  FunctionStatistics *fn_stats_;
   FunctionCall *parent_;
+  FunctionCall *shadow_;
   Address frame_;
+  long num_child_calls_;
+  long num_descendant_calls_;
   PerformanceCounter timer_;
 };
 
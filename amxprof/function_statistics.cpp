@@ -22,22 +22,54 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <cassert>
 #include "function_statistics.h"
 
 namespace amxprof {
 
-FunctionStatistics::FunctionStatistics(Function *fn)
+FunctionStatistics::FunctionStatistics(Function *fn, int id)
  : fn_(fn),
-   num_calls_(0)
+   id_(id),
+   active_call_(0),
+   num_calls_(0),
+   num_child_calls_(0),
+   num_outer_calls_(0),
+   num_descendant_calls_(0),
+   self_time_(0),
+   total_time_(0),
+   worst_self_time_(0),
+   worst_total_time_(0)
 {
 }
 
-void FunctionStatistics::AdjustSelfTime(Nanoseconds delta) {
+void FunctionStatistics::AdjustSelfTime(Ticks delta) {
   self_time_ += delta;
 }
 
-void FunctionStatistics::AdjustTotalTime(Nanoseconds delta) {
+void FunctionStatistics::AdjustTotalTime(Ticks delta) {
   total_time_ += delta;
 }
 
+void FunctionStatistics::RecordCallTimes(Ticks self_time, Ticks total_time) {
+  self_time_histogram_.Record(self_time);
+  total_time_histogram_.Record(total_time);
+}
+
+Ticks FunctionStatistics::GetAdjustedSelfTime(const Overhead &overhead) const {
+  Ticks time = self_time_
+             - num_calls_ * overhead.call_time
+             - num_child_calls_ * overhead.child_time;
+  return time > 0 ? time : 0;
+}
+
+Ticks FunctionStatistics::GetAdjustedTotalTime(const Overhead &overhead) const {
+  // Each nested call adds its whole overhead to the total time.
+  assert(num_outer_calls_ <= num_calls_);
+  Ticks time = total_time_
+             - num_outer_calls_ * overhead.call_time
+             - num_descendant_calls_ * (overhead.call_time +
+                                        overhead.child_time);
+  return time > 0 ? time : 0;
+}
+
 } // namespace amxprof
@@ -25,47 +25,102 @@
 #ifndef AMXPROF_FUNCTION_INFO_H
 #define AMXPROF_FUNCTION_INFO_H
 
-#include "duration.h"
+#include "clock.h"
+#include "histogram.h"
 
 namespace amxprof {
 
 class Function;
+class FunctionCall;
 
-// Various runtime information about a function.
+// The profiler's own bookkeeping cost that ends up in measured times, see
+// Profiler::Calibrate().
+struct Overhead {
+  Overhead() : call_time(0), child_time(0) {}
+
+  // Time added to the self time of every call.
+  Ticks call_time;
+
+  // Time added to the self time of the caller for each call it makes.
+  Ticks child_time;
+};
+
+// Various runtime information about a function. Times are kept in raw
+// clock ticks and converted to real time only when they are reported.
 class FunctionStatistics {
  public:
-  explicit FunctionStatistics(Function *fn);
+  explicit FunctionStatistics(Function *fn, int id = -1);
 
   Function *function() { return fn_; }
   const Function *function() const { return fn_; }
 
+  // Position of the statistics in their Statistics' table, see
+  // Statistics::GetStatisticsById().
+  int id() const { return id_; }
+
   long num_calls() const { return num_calls_; }
   void AdjustNumCalls(long delta) { num_calls_ += delta; }
 
-  Nanoseconds self_time() const { return self_time_; }
-  Nanoseconds total_time() const { return total_time_; }
+  long num_child_calls() const { return num_child_calls_; }
+  void AdjustNumChildCalls(long delta) { num_child_calls_ += delta; }
+
+  // Recursive calls don't add to total_time(), their outermost call
+  // covers them. These count only the calls that do (i.e. the ones made
+  // while the function wasn't already running) and the calls nested in
+  // them, to tell how much overhead there is in total_time().
+  long num_outer_calls() const { return num_outer_calls_; }
+  void AdjustNumOuterCalls(long delta) { num_outer_calls_ += delta; }
 
-  Nanoseconds worst_self_time() const { return worst_self_time_; }
-  Nanoseconds worst_total_time() const { return worst_total_time_; }
+  long num_descendant_calls() const { return num_descendant_calls_; }
+  void AdjustNumDescendantCalls(long delta) { num_descendant_calls_ += delta; }
 
-  void set_worst_self_time(Nanoseconds worst_self_time) {
+  Ticks self_time() const { return self_time_; }
+  Ticks total_time() const { return total_time_; }
+
+  Ticks worst_self_time() const { return worst_self_time_; }
+  Ticks worst_total_time() const { return worst_total_time_; }
+
+  void set_worst_self_time(Ticks worst_self_time) {
     worst_self_time_ = worst_self_time;
   }
 
-  void set_worst_total_time(Nanoseconds worst_total_time) {
+  void set_worst_total_time(Ticks worst_total_time) {
     worst_total_time_ = worst_total_time;
   }
 
-  void AdjustSelfTime(Nanoseconds delta);
-  void AdjustTotalTime(Nanoseconds delta);
+  void AdjustSelfTime(Ticks delta);
+  void AdjustTotalTime(Ticks delta);
+
+  // Distributions of self and total times of individual calls.
+  const Histogram &self_time_histogram() const { return self_time_histogram_; }
+  const Histogram &total_time_histogram() const { return total_time_histogram_; }
+
+  void RecordCallTimes(Ticks self_time, Ticks total_time);
+
+  // Same as self_time() and total_time() but with the profiler's overhead
+  // subtracted.
+  Ticks GetAdjustedSelfTime(const Overhead &overhead) const;
+  Ticks GetAdjustedTotalTime(const Overhead &overhead) const;
+
+  // Returns the innermost call of the function that is currently on the
+  // call stack, or 0 if the function is not running.
+  FunctionCall *active_call() const { return active_call_; }
+  void set_active_call(FunctionCall *call) { active_call_ = call; }
 
  private:
   Function *fn_;
+  int id_;
+  FunctionCall *active_call_;
   long num_calls_;
-  Nanoseconds self_time_;
-  Nanoseconds total_time_;
-  Nanoseconds worst_self_time_;
-  Nanoseconds worst_total_time_;
+  long num_child_calls_;
+  long num_outer_calls_;
+  long num_descendant_calls_;
+  Ticks self_time_;
+  Ticks total_time_;
+  Ticks worst_self_time_;
+  Ticks worst_total_time_;
+  Histogram self_time_histogram_;
+  Histogram total_time_histogram_;
 };
 
 } // namespace amxprof
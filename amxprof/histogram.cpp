@@ -0,0 +1,114 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "histogram.h"
+
+namespace amxprof {
+
+namespace {
+
+// Returns the index of the highest set bit of a positive value.
+int GetHighestBit(Ticks value) {
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift /= 2) {
+    if ((value >> shift) != 0) {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+} // anonymous namespace
+
+Histogram::Histogram()
+ : count_(0),
+   max_value_(0)
+{
+  std::fill(counts_, counts_ + kNumBuckets, 0);
+}
+
+Histogram &Histogram::operator=(const Histogram &other) {
+  int last = GetBucketIndex(std::max(max_value_, other.max_value_));
+  std::copy(other.counts_, other.counts_ + last + 1, counts_);
+  count_ = other.count_;
+  max_value_ = other.max_value_;
+  return *this;
+}
+
+void Histogram::Record(Ticks value) {
+  counts_[GetBucketIndex(value)]++;
+  count_++;
+  if (value > max_value_) {
+    max_value_ = value;
+  }
+}
+
+Ticks Histogram::GetValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  // Number of values that must be at or below the result.
+  double rank = percentile / 100 * count_;
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  unsigned long seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return std::min(GetBucketUpperBound(i), max_value_);
+    }
+  }
+
+  return max_value_;
+}
+
+int Histogram::GetBucketIndex(Ticks value) {
+  if (value < kSubBuckets) {
+    return value > 0 ? static_cast<int>(value) : 0;
+  }
+
+  // Keep the kSubBucketBits highest bits of the value, the top one of which
+  // is always set.
+  int shift = GetHighestBit(value) - (kSubBucketBits - 1);
+  int sub_bucket = static_cast<int>(value >> shift) - kSubBuckets / 2;
+  return kSubBuckets + (shift - 1) * (kSubBuckets / 2) + sub_bucket;
+}
+
+Ticks Histogram::GetBucketUpperBound(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  int shift = (index - kSubBuckets) / (kSubBuckets / 2) + 1;
+  Ticks sub_bucket = (index - kSubBuckets) % (kSubBuckets / 2)
+                   + kSubBuckets / 2;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+} // namespace amxprof
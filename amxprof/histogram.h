@@ -0,0 +1,71 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_HISTOGRAM_H
+#define AMXPROF_HISTOGRAM_H
+
+#include "clock.h"
+
+namespace amxprof {
+
+// Histogram counts values in log-linear buckets, similar to HdrHistogram:
+// values below kSubBuckets get a bucket each and every following power of
+// two range is split into kSubBuckets / 2 equal buckets. This keeps the
+// relative error of reported values under 1 / (kSubBuckets / 2) over the
+// whole range of Ticks with a fixed amount of memory.
+class Histogram {
+ public:
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kNumBuckets = kSubBuckets + (62 - kSubBucketBits + 1)
+                                             * (kSubBuckets / 2);
+
+  Histogram();
+
+  // Copies only the buckets up to the larger of the two maximum values,
+  // the rest are empty in both histograms.
+  Histogram &operator=(const Histogram &other);
+
+  void Record(Ticks value);
+
+  unsigned long count() const { return count_; }
+
+  // Returns the value at the given percentile (0 to 100), i.e. the upper
+  // bound of the bucket containing it but no more than the largest recorded
+  // value, or 0 if nothing has been recorded.
+  Ticks GetValueAtPercentile(double percentile) const;
+
+ private:
+  static int GetBucketIndex(Ticks value);
+  static Ticks GetBucketUpperBound(int index);
+
+ private:
+  unsigned long count_;
+  Ticks max_value_;
+  unsigned long counts_[kNumBuckets];
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_HISTOGRAM_H
@@ -0,0 +1,76 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include "json_utils.h"
+
+namespace amxprof {
+
+std::string EscapeJsonString(const std::string &s) {
+  std::string t;
+
+  for (std::string::const_iterator iterator = s.begin();
+       iterator != s.end(); ++iterator) {
+    switch (*iterator) {
+      // According to http://www.json.org other escape sequences,
+      // apart from Unicode, are not supported by JSON.
+      case '"': t.append("\\\""); break;
+      case '\\': t.append("\\\\"); break;
+      case '\b': t.append("\\b"); break;
+      case '\f': t.append("\\f"); break;
+      case '\n': t.append("\\n"); break;
+      case '\r': t.append("\\r"); break;
+      case '\t': t.append("\\t"); break;
+      default: t.push_back(*iterator);
+    }
+  }
+
+  return t;
+}
+
+void WriteJsonString(std::ostream &stream, const char *s, std::size_t size) {
+  const char *end = s + size;
+  const char *run = s;
+
+  for (; s != end; ++s) {
+    const char *escape;
+    switch (*s) {
+      case '"': escape = "\\\""; break;
+      case '\\': escape = "\\\\"; break;
+      case '\b': escape = "\\b"; break;
+      case '\f': escape = "\\f"; break;
+      case '\n': escape = "\\n"; break;
+      case '\r': escape = "\\r"; break;
+      case '\t': escape = "\\t"; break;
+      default: continue;
+    }
+    stream.write(run, s - run);
+    stream << escape;
+    run = s + 1;
+  }
+
+  stream.write(run, end - run);
+}
+
+} // namespace amxprof
@@ -0,0 +1,75 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <map>
+#include <utility>
+#include "debug_info.h"
+#include "line_statistics.h"
+
+namespace amxprof {
+
+LineStatistics::LineStatistics(Address code_size) {
+  Entry empty = {0, 0};
+  entries_.resize(code_size / sizeof(cell), empty);
+}
+
+void LineStatistics::GetLines(const DebugInfo *debug_info,
+                              std::vector<Line> &lines) const {
+  typedef std::map<std::pair<std::string, long>, std::size_t> LineMap;
+  LineMap line_map;
+
+  for (std::size_t i = 0; i < entries_.size(); i++) {
+    const Entry &entry = entries_[i];
+    if (entry.num_hits == 0 && entry.time == 0) {
+      continue;
+    }
+
+    Address address = static_cast<Address>(i * sizeof(cell));
+    long line = debug_info->LookupLine(address);
+    if (debug_info->last_error() != AMX_ERR_NONE) {
+      continue;
+    }
+    std::string file = debug_info->LookupFile(address);
+
+    std::pair<LineMap::iterator, bool> result =
+      line_map.insert(std::make_pair(std::make_pair(file, line),
+                                     lines.size()));
+    if (result.second) {
+      Line new_line;
+      new_line.file = file;
+      // amxdbg counts lines from 0.
+      new_line.line = line + 1;
+      new_line.function = debug_info->LookupFunction(address);
+      new_line.num_hits = 0;
+      new_line.time = 0;
+      lines.push_back(new_line);
+    }
+
+    Line &source_line = lines[result.first->second];
+    source_line.num_hits += entry.num_hits;
+    source_line.time += entry.time;
+  }
+}
+
+} // namespace amxprof
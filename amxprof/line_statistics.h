@@ -0,0 +1,98 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_LINE_STATISTICS_H
+#define AMXPROF_LINE_STATISTICS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "amx_types.h"
+#include "clock.h"
+
+namespace amxprof {
+
+class DebugInfo;
+
+// LineStatistics counts how many times each line of the script was run and
+// how much time was spent on it. A line's time runs from its BREAK
+// instruction to the next one, minus the time of natives it calls; script
+// functions have BREAKs of their own. Since nothing marks a return, the
+// rest of the calling line after a function returns is charged to the
+// last line of that function. There is one entry per code cell so that
+// recording a line is a single array access; entries are mapped to source
+// lines only when they are read.
+class LineStatistics {
+ public:
+  // A source line and everything recorded for it. Lines are numbered
+  // from 1.
+  struct Line {
+    std::string file;
+    long line;
+    std::string function;
+    long num_hits;
+    Ticks time;
+  };
+
+  // code_size is the size of the script's code section in bytes.
+  explicit LineStatistics(Address code_size);
+
+  // Lines are identified by the address of their BREAK instruction.
+  // Addresses outside of the code section are ignored.
+  void AddHit(Address address) {
+    Entry *entry = GetEntry(address);
+    if (entry != 0) {
+      entry->num_hits++;
+    }
+  }
+  void AddTime(Address address, Ticks time) {
+    Entry *entry = GetEntry(address);
+    if (entry != 0) {
+      entry->time += time;
+    }
+  }
+
+  // Merges the entries that belong to the same line of the same file, as
+  // told by debug_info, and stores them in lines in no particular order.
+  // Entries that debug_info knows nothing about are left out.
+  void GetLines(const DebugInfo *debug_info, std::vector<Line> &lines) const;
+
+ private:
+  struct Entry {
+    long num_hits;
+    Ticks time;
+  };
+
+  Entry *GetEntry(Address address) {
+    std::size_t index = static_cast<std::size_t>(address) / sizeof(cell);
+    return (address >= 0 && index < entries_.size()) ? &entries_[index] : 0;
+  }
+
+ private:
+  std::vector<Entry> entries_;
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_LINE_STATISTICS_H
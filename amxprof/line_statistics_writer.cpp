@@ -0,0 +1,131 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "clock.h"
+#include "duration.h"
+#include "line_statistics.h"
+#include "line_statistics_writer.h"
+#include "time_utils.h"
+
+static const int kFileWidth = 32;
+static const int kLineWidth = 8;
+static const int kFunctionWidth = 32;
+static const int kHitsWidth = 12;
+static const int kTimePercentWidth = 15;
+static const int kTimeWidth = 15;
+static const int kAvgTimeWidth = 15;
+
+static const int kWidthAll = kFileWidth + kLineWidth + kFunctionWidth
+  + kHitsWidth + kTimePercentWidth + kTimeWidth + kAvgTimeWidth;
+
+static const int kNumColumns = 7;
+
+namespace {
+
+bool CompareTime(const amxprof::LineStatistics::Line &left,
+                 const amxprof::LineStatistics::Line &right) {
+  return left.time > right.time;
+}
+
+} // anonymous namespace
+
+namespace amxprof {
+
+LineStatisticsWriter::LineStatisticsWriter()
+ : stream_(0),
+   print_date_(false)
+{
+}
+
+void LineStatisticsWriter::DoHLine() {
+  char fillch = stream()->fill();
+  *stream() << std::setw(kWidthAll + kNumColumns * 2 + 1)
+            << std::setfill('-') << "" << std::setfill(fillch) << '\n';
+}
+
+void LineStatisticsWriter::Write(const LineStatistics *line_stats,
+                                 const DebugInfo *debug_info) {
+  *stream() << "Line profile of '" << script_name() << "'";
+  if (print_date()) {
+    *stream() << " generated on " << CTime();
+  }
+  *stream() << "\n";
+
+  std::vector<LineStatistics::Line> lines;
+  line_stats->GetLines(debug_info, lines);
+  std::sort(lines.begin(), lines.end(), CompareTime);
+
+  Ticks time_all = 0;
+  for (std::vector<LineStatistics::Line>::const_iterator iterator =
+         lines.begin(); iterator != lines.end(); ++iterator) {
+    time_all += iterator->time;
+  }
+
+  DoHLine();
+  *stream() << std::left
+    << "| " << std::setw(kFileWidth) << "File"
+    << "| " << std::setw(kLineWidth) << "Line"
+    << "| " << std::setw(kFunctionWidth) << "Function"
+    << "| " << std::setw(kHitsWidth) << "Hits"
+    << "| " << std::setw(kTimePercentWidth) << "Time (%)"
+    << "| " << std::setw(kTimeWidth) << "Time (s)"
+    << "| " << std::setw(kAvgTimeWidth) << "Avg. Time (us)"
+    << "|\n";
+  DoHLine();
+
+  std::ostream::fmtflags flags = stream()->flags();
+  stream()->flags(flags | std::ostream::fixed);
+
+  for (std::vector<LineStatistics::Line>::const_iterator iterator =
+         lines.begin(); iterator != lines.end(); ++iterator) {
+    const LineStatistics::Line &line = *iterator;
+
+    double time_percent = (time_all > 0)
+      ? static_cast<double>(line.time) * 100 / time_all
+      : 0;
+    double time = Seconds(Clock::ToNanoseconds(line.time)).count();
+    double avg_time = (line.num_hits > 0)
+      ? Microseconds(Clock::ToNanoseconds(line.time)).count() / line.num_hits
+      : 0;
+
+    *stream()
+      << "| " << std::setw(kFileWidth) << line.file
+      << "| " << std::setw(kLineWidth) << line.line
+      << "| " << std::setw(kFunctionWidth) << line.function
+      << "| " << std::setw(kHitsWidth) << line.num_hits
+      << "| " << std::setw(kTimePercentWidth) << std::setprecision(2) << time_percent
+      << "| " << std::setw(kTimeWidth) << std::setprecision(3) << time
+      << "| " << std::setw(kAvgTimeWidth) << std::setprecision(3) << avg_time
+      << "|\n";
+  }
+  DoHLine();
+
+  stream()->flags(flags);
+}
+
+} // namespace amxprof
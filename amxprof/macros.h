@@ -32,4 +32,15 @@
   TypeName(const TypeName&); \
   void operator=(const TypeName&)
 
+// Prevents the compiler from moving memory accesses across this point. On
+// x86 this is enough to order stores with respect to other stores and loads
+// with respect to other loads, as observed by other threads and by signal
+// handlers.
+#if defined _MSC_VER
+  #include <intrin.h>
+  #define COMPILER_BARRIER() _ReadWriteBarrier()
+#else
+  #define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
 #endif // !AMXPROF_MACROS_H
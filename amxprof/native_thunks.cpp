@@ -0,0 +1,131 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "native_thunks.h"
+#include "profiler.h"
+
+namespace amxprof {
+
+namespace {
+
+struct NativeThunkInfo {
+  // amx and profiler are 0 if the thunk is not in use.
+  AMX *amx;
+  Profiler *profiler;
+  NativeTableIndex index;
+  AMX_NATIVE native;
+};
+
+NativeThunkInfo thunk_info[kMaxNativeThunks];
+
+// Thunks above this one have never been used.
+NativeTableIndex num_used_thunks = 0;
+
+cell CallNativeHook(NativeTableIndex thunk, AMX *amx, cell *params) {
+  const NativeThunkInfo &info = thunk_info[thunk];
+  if (info.amx == amx && info.profiler != 0) {
+    return info.profiler->NativeHook(info.index, params);
+  }
+  if (info.native == 0) {
+    amx_RaiseError(amx, AMX_ERR_NATIVE);
+    return 0;
+  }
+  return info.native(amx, params);
+}
+
+template<NativeTableIndex Index>
+cell AMX_NATIVE_CALL NativeThunk(AMX *amx, cell *params) {
+  return CallNativeHook(Index, amx, params);
+}
+
+// Fills table[Begin] through table[Begin + Count - 1] with thunks. The range
+// is split in halves to keep the template recursion shallow.
+template<NativeTableIndex Begin, NativeTableIndex Count>
+struct ThunkTableFiller {
+  static void Fill(AMX_NATIVE *table) {
+    ThunkTableFiller<Begin, Count / 2>::Fill(table);
+    ThunkTableFiller<Begin + Count / 2, Count - Count / 2>::Fill(table);
+  }
+};
+
+template<NativeTableIndex Begin>
+struct ThunkTableFiller<Begin, 1> {
+  static void Fill(AMX_NATIVE *table) {
+    table[Begin] = NativeThunk<Begin>;
+  }
+};
+
+AMX_NATIVE GetNativeThunk(NativeTableIndex thunk) {
+  static AMX_NATIVE thunks[kMaxNativeThunks];
+  static bool initialized = false;
+
+  if (!initialized) {
+    ThunkTableFiller<0, kMaxNativeThunks>::Fill(thunks);
+    initialized = true;
+  }
+
+  return thunks[thunk];
+}
+
+// A released thunk may still be called through a stale address, so it is
+// only handed out again for the same native. Returns -1 if there is no
+// such thunk and all the others have been used.
+NativeTableIndex FindFreeThunk(AMX_NATIVE native) {
+  for (NativeTableIndex i = 0; i < num_used_thunks; i++) {
+    if (thunk_info[i].amx == 0 && thunk_info[i].native == native) {
+      return i;
+    }
+  }
+  if (num_used_thunks < kMaxNativeThunks) {
+    return num_used_thunks++;
+  }
+  return -1;
+}
+
+} // anonymous namespace
+
+AMX_NATIVE CreateNativeThunk(AMX *amx, Profiler *profiler,
+                             NativeTableIndex index, AMX_NATIVE native) {
+  NativeTableIndex thunk = FindFreeThunk(native);
+  if (thunk < 0) {
+    return 0;
+  }
+  NativeThunkInfo &info = thunk_info[thunk];
+  info.amx = amx;
+  info.profiler = profiler;
+  info.index = index;
+  info.native = native;
+  return GetNativeThunk(thunk);
+}
+
+void DestroyNativeThunks(AMX *amx) {
+  for (NativeTableIndex i = 0; i < num_used_thunks; i++) {
+    if (thunk_info[i].amx == amx) {
+      thunk_info[i].amx = 0;
+      thunk_info[i].profiler = 0;
+    }
+  }
+}
+
+} // namespace amxprof
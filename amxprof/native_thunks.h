@@ -0,0 +1,58 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_NATIVE_THUNKS_H
+#define AMXPROF_NATIVE_THUNKS_H
+
+#include "amx_types.h"
+
+namespace amxprof {
+
+class Profiler;
+
+// Native thunks stand in for real natives in the native table of an AMX
+// and pass each call on to Profiler::NativeHook(). Since they are plain
+// AMX_NATIVE functions the AMX can still turn SYSREQ.C into SYSREQ.D and
+// call them directly.
+//
+// Thunks are taken from a pool shared by all scripts. Each one remembers
+// the script and the native it replaced, so it doesn't rely on the AMX it
+// is called with: other plugins may read a thunk from the native table
+// and call it with a different AMX, and then the original native is
+// called without profiling.
+const NativeTableIndex kMaxNativeThunks = 2048;
+
+// Returns a thunk that replaces the specified native of amx, or 0 if no
+// thunk is available for it.
+AMX_NATIVE CreateNativeThunk(AMX *amx, Profiler *profiler,
+                             NativeTableIndex index, AMX_NATIVE native);
+
+// Releases the thunks of amx. They keep calling the original natives, in
+// case their addresses were copied somewhere, and are only reused for the
+// same natives.
+void DestroyNativeThunks(AMX *amx);
+
+} // namespace amxprof
+
+#endif // !AMXPROF_NATIVE_THUNKS_H
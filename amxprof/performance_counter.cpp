@@ -36,7 +36,13 @@ PerformanceCounter::PerformanceCounter(PerformanceCounter *parent,
 
 void PerformanceCounter::Start() {
   if (!started_) {
-    start_point_ = Clock::Now();
+    Start(Clock::Now());
+  }
+}
+
+void PerformanceCounter::Start(TimePoint now) {
+  if (!started_) {
+    start_point_ = now;
     ResetTimes();
     started_ = true;
   }
@@ -44,7 +50,14 @@ void PerformanceCounter::Start() {
 
 void PerformanceCounter::Stop() {
   if (started_) {
-    Nanoseconds time = QueryTotalTime();
+    Stop(Clock::Now());
+  }
+}
+
+void PerformanceCounter::Stop(TimePoint now) {
+  if (started_) {
+    Ticks time = now - start_point_;
+    stop_point_ = now;
 
     if (shadow_ != 0) {
       latest_total_time_ = 0;
@@ -37,26 +37,35 @@ class PerformanceCounter {
   void Start();
   void Stop();
 
+  // Same as above but use the given time instead of reading the clock.
+  void Start(TimePoint now);
+  void Stop(TimePoint now);
+
   void ResetTimes();
 
-  Nanoseconds QueryTotalTime() const {
+  // All times are measured in raw clock ticks, see Clock::ToNanoseconds().
+  Ticks QueryTotalTime() const {
     return Clock::Now() - start_point_;
   }
 
+  // When the counter was last started and stopped.
+  TimePoint start_point() const { return start_point_; }
+  TimePoint stop_point() const { return stop_point_; }
+
   void set_parent(PerformanceCounter *parent) { parent_ = parent; }
   void set_shadow(PerformanceCounter *shadow) { shadow_ = shadow; }
 
-  Nanoseconds latest_total_time() const { return latest_total_time_; }
-  Nanoseconds latest_child_time() const { return latest_child_time_; }
+  Ticks latest_total_time() const { return latest_total_time_; }
+  Ticks latest_child_time() const { return latest_child_time_; }
 
-  Nanoseconds latest_self_time() const {
+  Ticks latest_self_time() const {
     return latest_total_time_ - latest_child_time_;
   }
 
-  Nanoseconds child_time() const { return child_time_; }
-  Nanoseconds total_time() const { return total_time_; }
+  Ticks child_time() const { return child_time_; }
+  Ticks total_time() const { return total_time_; }
 
-  Nanoseconds self_time() const {
+  Ticks self_time() const {
     return total_time_ - child_time_;
   }
 
@@ -67,11 +76,12 @@ class PerformanceCounter {
   PerformanceCounter *shadow_;
 
   TimePoint start_point_;
+  TimePoint stop_point_;
 
-  Nanoseconds latest_total_time_;
-  Nanoseconds latest_child_time_;
-  Nanoseconds child_time_;
-  Nanoseconds total_time_;
+  Ticks latest_total_time_;
+  Ticks latest_child_time_;
+  Ticks child_time_;
+  Ticks total_time_;
 };
 
 } // namespace amxprof
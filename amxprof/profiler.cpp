@@ -23,55 +23,344 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <cassert>
+#include <limits>
 #include "amx_utils.h"
+#include "exception.h"
 #include "function.h"
 #include "function_call.h"
 #include "function_statistics.h"
+#include "native_thunks.h"
 #include "profiler.h"
+#include "thread.h"
+#include "trace_recorder.h"
 
 namespace amxprof {
 
-Profiler::Profiler(AMX *amx, DebugInfo *debug_info)
+namespace {
+
+// Calibrate() makes kCalibrationRuns runs of kCalibrationCalls calls each
+// and takes the lowest measured overhead.
+const int kCalibrationRuns = 10;
+const int kCalibrationCalls = 1000;
+
+// How many times the aggregation thread yields when it runs out of events
+// before it starts sleeping.
+const int kAggregationSpinCount = 100;
+
+// The current line when no code is running.
+const Address kNoLine = -1;
+
+// Stops the AMX from patching SYSREQ.C to SYSREQ.D while it's in scope.
+class ScopedDisableSysreqD {
+ public:
+  explicit ScopedDisableSysreqD(AMX *amx)
+   : amx_(amx),
+     sysreq_d_(amx->sysreq_d)
+  {
+    amx_->sysreq_d = 0;
+  }
+  ~ScopedDisableSysreqD() { amx_->sysreq_d = sysreq_d_; }
+ private:
+  AMX *amx_;
+  cell sysreq_d_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedDisableSysreqD);
+};
+
+} // anonymous namespace
+
+Profiler::Profiler(AMX *amx, DebugInfo *debug_info,
+                   std::size_t max_call_depth)
  : amx_(amx),
    debug_info_(debug_info),
-   call_graph_enabled_(false)
+   call_graph_enabled_(false),
+   trace_recorder_(0),
+   call_stack_(max_call_depth),
+   stats_(GetNumNatives(amx), GetNumPublics(amx)),
+   sampler_(0),
+   events_(0),
+   aggregation_thread_(0),
+   stop_aggregation_(false),
+   num_events_(0),
+   num_processed_events_(0),
+   num_pending_calls_(0),
+   line_stats_(0),
+   current_line_(kNoLine),
+   overflow_frame_(0),
+   num_dropped_calls_(0)
 {
-  // The AMX VM normally replaces SYSREQ.C instructions with SYSREQ.D
-  // to speed up native calls. We don't want this to happen as then we
-  // would be unable to profile native functions.
-  amx->sysreq_d = 0;
+  if (stats_.num_natives() <= kMaxNativeThunks) {
+    natives_.resize(stats_.num_natives(), 0);
+  } else {
+    // The AMX VM normally replaces SYSREQ.C instructions with SYSREQ.D
+    // to speed up native calls. Without thunks we don't want this to
+    // happen as then we would be unable to profile native functions.
+    amx->sysreq_d = 0;
+  }
 }
 
 Profiler::~Profiler() {
+  Detach();
+  delete events_;
+  delete line_stats_;
   for (FunctionSet::const_iterator iterator = functions_.begin();
        iterator != functions_.end(); ++iterator) {
     delete *iterator;
   }
 }
 
+void Profiler::Detach() {
+  if (amx_ == 0) {
+    return;
+  }
+
+  if (aggregation_thread_ != 0) {
+    // The thread processes the remaining events before it exits.
+    stop_aggregation_ = true;
+    aggregation_thread_->Join();
+    delete aggregation_thread_;
+    aggregation_thread_ = 0;
+  }
+
+  for (std::size_t i = 0; i < natives_.size(); i++) {
+    if (natives_[i] != 0) {
+      SetNativeAddress(amx_, i, reinterpret_cast<Address>(natives_[i]));
+    }
+  }
+  DestroyNativeThunks(amx_);
+
+  delete sampler_;
+  sampler_ = 0;
+
+  amx_ = 0;
+}
+
+void Profiler::Calibrate() {
+  assert(!is_executing());
+
+  // The aggregation thread checks whether the call graph is enabled while
+  // it processes events.
+  UpdateStatistics();
+
+  // Don't let the dummy functions get into the call graph or the trace.
+  bool call_graph_enabled = call_graph_enabled_;
+  call_graph_enabled_ = false;
+  TraceRecorder *trace_recorder = trace_recorder_;
+  trace_recorder_ = 0;
+
+  Function *fn = Function::Normal(0);
+  Overhead overhead;
+  overhead.call_time = std::numeric_limits<Ticks>::max();
+  overhead.child_time = std::numeric_limits<Ticks>::max();
+
+  for (int i = 0; i < kCalibrationRuns; i++) {
+    FunctionStatistics caller(fn);
+    FunctionStatistics callee(fn);
+
+    BeginFunction(&caller, 0);
+    for (int j = 0; j < kCalibrationCalls; j++) {
+      BeginFunction(&callee, 0);
+      EndFunction(&callee);
+    }
+    EndFunction(&caller);
+    UpdateStatistics();
+
+    // The callee's body is empty so all of its time is overhead, and the
+    // caller's self time is its own overhead plus that of its children.
+    Ticks call_time = callee.total_time() / kCalibrationCalls;
+    Ticks child_time = (caller.self_time() - call_time) / kCalibrationCalls;
+
+    if (call_time < overhead.call_time) {
+      overhead.call_time = call_time;
+    }
+    if (child_time < overhead.child_time) {
+      overhead.child_time = child_time > 0 ? child_time : 0;
+    }
+  }
+
+  delete fn;
+  stats_.set_overhead(overhead);
+  call_graph_enabled_ = call_graph_enabled;
+  trace_recorder_ = trace_recorder;
+}
+
+void Profiler::StartSampling(Nanoseconds interval) {
+  assert(sampler_ == 0);
+  sampler_ = new Sampler(amx_, interval);
+  try {
+    sampler_->Start();
+  } catch (...) {
+    delete sampler_;
+    sampler_ = 0;
+    throw;
+  }
+  stats_.set_sampled(true);
+}
+
+void Profiler::StartAsync(std::size_t buffer_size) {
+  assert(events_ == 0 && sampler_ == 0);
+  assert(!is_executing());
+
+  pending_calls_.resize(call_stack_.max_depth());
+  events_ = new RingBuffer<CallEvent>(buffer_size);
+  aggregation_thread_ = new Thread(ProcessEvents, this);
+  try {
+    aggregation_thread_->Start();
+  } catch (...) {
+    delete aggregation_thread_;
+    aggregation_thread_ = 0;
+    delete events_;
+    events_ = 0;
+    throw;
+  }
+}
+
+bool Profiler::is_executing() const {
+  if (sampler_ != 0) {
+    return sampler_->current_public() != Sampler::kNoIndex;
+  }
+  if (events_ != 0) {
+    return num_pending_calls_ != 0;
+  }
+  return !call_stack_.is_empty();
+}
+
+void Profiler::UpdateStatistics() {
+  ProcessSamples();
+  if (events_ != 0) {
+    while (num_processed_events_ != num_events_) {
+      events_drained_.Wait();
+    }
+    // Don't let the caller read the statistics before the loop is over.
+    COMPILER_BARRIER();
+  }
+  ResolveNames();
+}
+
+void Profiler::ResolveNames() {
+  if (unnamed_functions_.empty()) {
+    return;
+  }
+  for (std::vector<Function*>::const_iterator iterator =
+         unnamed_functions_.begin();
+       iterator != unnamed_functions_.end(); ++iterator) {
+    (*iterator)->ResolveName(&names_, debug_info_);
+  }
+  unnamed_functions_.clear();
+  // The trace may already refer to some of these functions. In async mode
+  // the aggregation thread is idle at this point, so it's safe to write to
+  // the trace from here.
+  if (trace_recorder_ != 0) {
+    trace_recorder_->RecordNames(&stats_);
+  }
+}
+
+const FunctionStatistics *Profiler::GetRunningFunction(Address &frame) const {
+  if (events_ != 0) {
+    if (num_pending_calls_ == 0) {
+      return 0;
+    }
+    frame = pending_calls_[num_pending_calls_ - 1].frame;
+    return pending_calls_[num_pending_calls_ - 1].fn_stats;
+  }
+  if (call_stack_.is_empty()) {
+    return 0;
+  }
+  frame = call_stack_.top()->frame();
+  return call_stack_.top()->stats();
+}
+
+void Profiler::ProcessSamples() {
+  if (sampler_ == 0) {
+    return;
+  }
+
+  Ticks interval = Clock::FromNanoseconds(sampler_->interval());
+  Sampler::Sample sample;
+
+  while (sampler_->PopSample(sample)) {
+    // Functions that were running when the sample was taken, innermost
+    // first.
+    FunctionStatistics *chain[Sampler::kMaxFrames + 2];
+    int chain_length = 0;
+
+    if (sample.native_index != Sampler::kNoIndex) {
+      chain[chain_length] = LookupNative(sample.native_index);
+      if (chain[chain_length] != 0) {
+        chain_length++;
+      }
+    }
+    for (int i = 0; i < sample.num_frames; i++) {
+      chain[chain_length] = LookupNormal(sample.frames[i]);
+      if (chain[chain_length] != 0) {
+        chain_length++;
+      }
+    }
+    chain[chain_length] = LookupPublic(sample.public_index);
+    if (chain[chain_length] != 0) {
+      chain_length++;
+    }
+
+    if (chain_length == 0) {
+      continue;
+    }
+
+    chain[0]->AdjustSelfTime(interval);
+
+    for (int i = 0; i < chain_length; i++) {
+      // Recursive functions appear in the chain more than once but must be
+      // counted only once per sample.
+      bool seen = false;
+      for (int j = 0; j < i && !seen; j++) {
+        seen = (chain[j] == chain[i]);
+      }
+      if (!seen) {
+        chain[i]->AdjustNumCalls(1);
+        chain[i]->AdjustTotalTime(interval);
+      }
+    }
+  }
+}
+
+void Profiler::StartLineProfiling() {
+  if (sampler_ != 0) {
+    throw Exception("Lines can't be profiled in sampling mode");
+  }
+  if (line_stats_ == 0) {
+    line_stats_ = new LineStatistics(GetCodeSize(amx_));
+  }
+}
+
 int Profiler::DebugHook(AMX_DEBUG debug) {
-  Address prev_frame = amx_->stp;
+  if (line_stats_ != 0) {
+    // cip points past the BREAK.
+    Address line = amx_->cip - static_cast<Address>(sizeof(cell));
+    line_stats_->AddHit(line);
+    EnterLine(line, Clock::Now());
+  }
 
-  if (!call_stack_.is_empty()) {
-    prev_frame = call_stack_.top()->frame();
+  // Functions called from one that didn't fit on the call stack are not
+  // profiled either, until it returns.
+  if (overflow_frame_ != 0 && amx_->frm > overflow_frame_) {
+    overflow_frame_ = 0;
   }
 
-  if (amx_->frm < prev_frame) {
-    if (call_stack_.top()->frame() != amx_->frm) {
-      Address address = GetCalleeAddress(amx_, amx_->frm);
-      if (address != 0) {
-        Function *fn = stats_.GetFunction(address);
-        if (fn == 0) {
-          fn = Function::Normal(address, debug_info_);
-          functions_.insert(fn);
-          stats_.AddFunction(fn);
+  if (sampler_ == 0 && overflow_frame_ == 0) {
+    Address prev_frame = amx_->stp;
+    const FunctionStatistics *top = GetRunningFunction(prev_frame);
+
+    if (amx_->frm < prev_frame) {
+      if (top == 0 || prev_frame != amx_->frm) {
+        Address address = GetCalleeAddress(amx_, amx_->frm);
+        if (address != 0
+            && !BeginFunction(LookupNormal(address), amx_->frm)) {
+          overflow_frame_ = amx_->frm;
         }
-        BeginFunction(address, amx_->frm);
       }
-    }
-  } else if (amx_->frm > prev_frame) {
-    if (call_stack_.top()->function()->type() == Function::NORMAL) {
-      EndFunction();
+    } else if (amx_->frm > prev_frame) {
+      if (top->function()->type() == Function::NORMAL) {
+        EndFunction();
+      }
     }
   }
 
@@ -87,25 +376,96 @@ int Profiler::CallbackHook(cell index, cell *result, cell *params, AMX_CALLBACK
     callback = ::amx_Callback;
   }
 
-  if (index >= 0) {
-    Address address = GetNativeAddress(amx_, index);
-    if (address != 0) {
-      Function *fn = stats_.GetFunction(address);
-      if (fn == 0) {
-        fn = Function::Native(amx_, index);
-        functions_.insert(fn);
-        stats_.AddFunction(fn);
+  // amx_Callback() reads the native's address after we've patched it, so
+  // the thunk takes care of this call as well.
+  if (InstallNativeThunk(index)) {
+    return callback(amx_, index, result, params);
+  }
+
+  // Without a thunk the native must keep going through amx_Callback(),
+  // so don't let it patch the call to SYSREQ.D.
+  ScopedDisableSysreqD disable_sysreq_d(amx_);
+
+  int error;
+  if (sampler_ != 0) {
+    NativeTableIndex prev_native = sampler_->current_native();
+    sampler_->set_current_native(index);
+    error = callback(amx_, index, result, params);
+    sampler_->set_current_native(prev_native);
+  } else {
+    Address line = current_line_;
+    if (line_stats_ != 0) {
+      EnterLine(kNoLine, Clock::Now());
+    }
+    FunctionStatistics *fn_stats = LookupNative(index);
+    if (fn_stats != 0) {
+      try {
+        if (!BeginFunction(fn_stats, amx_->frm)) {
+          fn_stats = 0;
+        }
+      } catch (const std::exception &) {
+        // The caller would call the native again if this threw. Just don't
+        // profile this call.
+        fn_stats = 0;
       }
-      BeginFunction(address, amx_->frm);
     }
-    int error = callback(amx_, index, result, params);
-    if (address != 0) {
-      EndFunction(address);
+    error = callback(amx_, index, result, params);
+    if (fn_stats != 0) {
+      EndFunction(fn_stats);
     }
-    return error;
+    if (line_stats_ != 0) {
+      EnterLine(line, Clock::Now());
+    }
+  }
+
+  return error;
+}
+
+cell Profiler::NativeHook(NativeTableIndex index, cell *params) {
+  if (index < 0 || index >= static_cast<NativeTableIndex>(natives_.size())
+      || natives_[index] == 0) {
+    amx_RaiseError(amx_, AMX_ERR_NATIVE);
+    return 0;
   }
 
-  return callback(amx_, index, result, params);
+  AMX_NATIVE native = natives_[index];
+
+  if (sampler_ != 0) {
+    NativeTableIndex prev_native = sampler_->current_native();
+    sampler_->set_current_native(index);
+    cell result = native(amx_, params);
+    sampler_->set_current_native(prev_native);
+    return result;
+  }
+
+  // The native's time is not charged to the line that called it.
+  Address line = current_line_;
+  if (line_stats_ != 0) {
+    EnterLine(kNoLine, Clock::Now());
+  }
+
+  FunctionStatistics *fn_stats = LookupNative(index);
+  if (fn_stats != 0) {
+    try {
+      if (!BeginFunction(fn_stats, amx_->frm)) {
+        fn_stats = 0;
+      }
+    } catch (const std::exception &) {
+      // Thunks are called directly by the AMX, so exceptions must not
+      // leave this function. Just don't profile this call.
+      fn_stats = 0;
+    }
+  }
+  cell result = native(amx_, params);
+  if (fn_stats != 0) {
+    EndFunction(fn_stats);
+  }
+
+  if (line_stats_ != 0) {
+    EnterLine(line, Clock::Now());
+  }
+
+  return result;
 }
 
 int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
@@ -113,72 +473,305 @@ int Profiler::ExecHook(cell *retval, int index, AMX_EXEC exec) {
     exec = ::amx_Exec;
   }
 
-  if (index >= 0 || index == AMX_EXEC_MAIN) {
-    Address address = GetPublicAddress(amx_, index);
-    if (address != 0) {
-      Function *fn = stats_.GetFunction(address);
-      if (fn == 0) {
-        fn = Function::Public(amx_, index);
-        functions_.insert(fn);
-        stats_.AddFunction(fn);
-      }
-      BeginFunction(address, amx_->stk - 3 * sizeof(cell));
-    }
+  if (sampler_ != 0 && (index >= 0 || index == AMX_EXEC_MAIN)) {
+    PublicTableIndex prev_public = sampler_->current_public();
+    sampler_->set_current_public(index);
     int error = exec(amx_, retval, index);
-    if (address != 0) {
-      EndFunction(address);
+    sampler_->set_current_public(prev_public);
+    if (prev_public == Sampler::kNoIndex) {
+      // Convert samples between top-level calls so that the buffer
+      // doesn't overflow.
+      ProcessSamples();
     }
     return error;
   }
 
-  return exec(amx_, retval, index);
+  // The last line run by this call ends when it returns, and the line
+  // that was running before it (if any) continues.
+  Address prev_line = current_line_;
+  int error;
+
+  FunctionStatistics *fn_stats = LookupPublic(index);
+  if (fn_stats != 0
+      && BeginFunction(fn_stats, amx_->stk - 3 * sizeof(cell))) {
+    error = exec(amx_, retval, index);
+    EndFunction(fn_stats);
+  } else {
+    error = exec(amx_, retval, index);
+  }
+
+  if (line_stats_ != 0) {
+    EnterLine(prev_line, Clock::Now());
+  }
+
+  return error;
+}
+
+bool Profiler::InstallNativeThunk(NativeTableIndex index) {
+  if (index < 0 || index >= static_cast<NativeTableIndex>(natives_.size())) {
+    return false;
+  }
+
+  if (natives_[index] == 0) {
+    Address address = GetNativeAddress(amx_, index);
+    if (address == 0) {
+      return false;
+    }
+    AMX_NATIVE native = reinterpret_cast<AMX_NATIVE>(address);
+    AMX_NATIVE thunk = CreateNativeThunk(amx_, this, index, native);
+    if (thunk == 0) {
+      return false;
+    }
+    natives_[index] = native;
+    SetNativeAddress(amx_, index, reinterpret_cast<Address>(thunk));
+  }
+
+  return true;
+}
+
+FunctionStatistics *Profiler::LookupNative(NativeTableIndex index) {
+  if (index < 0 || index >= stats_.num_natives()) {
+    return 0;
+  }
+
+  FunctionStatistics *fn_stats = stats_.GetNativeStatistics(index);
+  if (fn_stats == 0 && GetNativeAddress(amx_, index) != 0) {
+    Function *fn = Function::Native(amx_, index, &names_);
+    functions_.insert(fn);
+    fn_stats = stats_.AddNative(index, fn);
+  }
+
+  return fn_stats;
+}
+
+FunctionStatistics *Profiler::LookupPublic(PublicTableIndex index) {
+  if ((index < 0 && index != AMX_EXEC_MAIN) || index >= stats_.num_publics()) {
+    return 0;
+  }
+
+  FunctionStatistics *fn_stats = stats_.GetPublicStatistics(index);
+  if (fn_stats == 0 && GetPublicAddress(amx_, index) != 0) {
+    Function *fn = Function::Public(amx_, index, &names_);
+    functions_.insert(fn);
+    fn_stats = stats_.AddPublic(index, fn);
+  }
+
+  return fn_stats;
 }
 
-void Profiler::BeginFunction(Address address, cell frm) {
-  assert(address != 0);
-  FunctionStatistics *fn_stats = stats_.GetFunctionStatistis(address);
+FunctionStatistics *Profiler::LookupNormal(Address address) {
+  FunctionStatistics *fn_stats = stats_.GetStatisticsByAddress(address);
+  if (fn_stats != 0) {
+    return fn_stats;
+  }
+
+  // A public function (or main) can be called directly just like any
+  // other function, in which case it should be attributed to that public.
+  if (GetPublicAddress(amx_, AMX_EXEC_MAIN) == address) {
+    return LookupPublic(AMX_EXEC_MAIN);
+  }
+  for (PublicTableIndex index = 0; index < stats_.num_publics(); index++) {
+    if (GetPublicAddress(amx_, index) == address) {
+      return LookupPublic(index);
+    }
+  }
 
+  // The name is looked up later by ResolveNames(), away from the script's
+  // first call of the function.
+  Function *fn = Function::Normal(address);
+  functions_.insert(fn);
+  unnamed_functions_.push_back(fn);
+  return stats_.AddNormal(fn);
+}
+
+bool Profiler::BeginFunction(FunctionStatistics *fn_stats, Address frm) {
   assert(fn_stats != 0);
-  fn_stats->AdjustNumCalls(1);
 
-  call_stack_.Push(fn_stats->function(), frm);
+  if (events_ != 0) {
+    if (num_pending_calls_ == pending_calls_.size()) {
+      num_dropped_calls_++;
+      return false;
+    }
+    PendingCall &call = pending_calls_[num_pending_calls_++];
+    call.fn_stats = fn_stats;
+    call.frame = frm;
+    PushEvent(fn_stats, CallEvent::BEGIN, Clock::Now());
+    return true;
+  }
+
+  if (call_stack_.depth() == call_stack_.max_depth()) {
+    num_dropped_calls_++;
+    return false;
+  }
+
+  fn_stats->AdjustNumCalls(1);
+  call_stack_.Push(fn_stats, frm);
   if (call_graph_enabled_) {
     call_graph_.AddCallee(fn_stats)->MakeRoot();
   }
+  if (trace_recorder_ != 0) {
+    trace_recorder_->RecordBegin(fn_stats,
+                                 call_stack_.top()->timer()->start_point());
+  }
+  return true;
 }
 
-void Profiler::EndFunction(Address address) {
+void Profiler::EndFunction(const FunctionStatistics *fn_stats) {
+  if (events_ != 0) {
+    TimePoint now = Clock::Now();
+    assert(num_pending_calls_ > 0);
+    while (true) {
+      FunctionStatistics *call_stats =
+        pending_calls_[--num_pending_calls_].fn_stats;
+      PushEvent(call_stats, CallEvent::END, now);
+      if (fn_stats == 0 || call_stats == fn_stats) {
+        break;
+      }
+    }
+    return;
+  }
+
   assert(!call_stack_.is_empty());
-  assert(address == 0 || stats_.GetFunction(address) != 0);
 
   while (true) {
-    FunctionCall fn_call = call_stack_.Pop();
+    FunctionCall &fn_call = call_stack_.Pop();
+    AddCall(fn_call);
+    if (fn_stats == 0 || fn_call.stats() == fn_stats) {
+      break;
+    }
+  }
+}
 
-    FunctionStatistics *fn_stats = stats_.GetFunctionStatistis(fn_call.function()->address());
-    assert(fn_stats != 0);
+void Profiler::AddCall(FunctionCall &fn_call) {
+  FunctionStatistics *call_stats = fn_call.stats();
 
-    fn_stats->AdjustSelfTime(fn_call.timer()->self_time());
-    fn_stats->AdjustTotalTime(fn_call.timer()->total_time());
+  call_stats->AdjustSelfTime(fn_call.timer()->self_time());
+  call_stats->AdjustTotalTime(fn_call.timer()->total_time());
+  call_stats->AdjustNumChildCalls(fn_call.num_child_calls());
+  if (fn_call.shadow() == 0) {
+    call_stats->AdjustNumOuterCalls(1);
+    call_stats->AdjustNumDescendantCalls(fn_call.num_descendant_calls());
+  }
 
-    Nanoseconds total_time = fn_call.timer()->latest_total_time();
-    if (total_time > fn_stats->worst_total_time()) {
-      fn_stats->set_worst_total_time(total_time);
-    }
+  Ticks total_time = fn_call.timer()->latest_total_time();
+  if (total_time > call_stats->worst_total_time()) {
+    call_stats->set_worst_total_time(total_time);
+  }
 
-    Nanoseconds self_time = fn_call.timer()->latest_self_time();
-    if (self_time > fn_stats->worst_self_time()) {
-      fn_stats->set_worst_self_time(self_time);
-    }
+  Ticks self_time = fn_call.timer()->latest_self_time();
+  if (self_time > call_stats->worst_self_time()) {
+    call_stats->set_worst_self_time(self_time);
+  }
 
-    if (call_graph_enabled_) {
-      assert(call_graph_.root() != call_graph_.sentinel());
-      call_graph_.set_root(call_graph_.root()->caller());
-    }
+  // A recursive call's total time is covered by its outermost call and is
+  // 0, but the histogram shows how long each call took.
+  call_stats->RecordCallTimes(self_time, fn_call.timer()->stop_point() -
+                                         fn_call.timer()->start_point());
+
+  if (call_graph_enabled_) {
+    CallGraphNode *node = call_graph_.root();
+    assert(node != call_graph_.sentinel());
+    // Unlike the function's own times, the node's times are not affected
+    // by recursive calls, those get a node of their own.
+    node->AddCall(fn_call.timer()->stop_point() -
+                  fn_call.timer()->start_point(),
+                  fn_call.num_descendant_calls());
+    call_graph_.set_root(node->caller());
+  }
 
-    if (address == 0 || fn_call.function()->address() == address) {
+  if (trace_recorder_ != 0) {
+    trace_recorder_->RecordEnd(call_stats, fn_call.timer()->stop_point());
+  }
+}
+
+void Profiler::EnterLine(Address line, TimePoint now) {
+  if (current_line_ != kNoLine) {
+    line_stats_->AddTime(current_line_, now - line_start_);
+  }
+  current_line_ = line;
+  line_start_ = now;
+}
+
+void Profiler::PushEvent(FunctionStatistics *fn_stats, CallEvent::Type type,
+                         TimePoint time) {
+  CallEvent event;
+  event.fn_stats = fn_stats;
+  event.type = type;
+  event.time = time.ticks();
+  // Dropping an event would leave the aggregation thread with a broken
+  // call stack, so wait for it to catch up instead.
+  while (!events_->Push(event)) {
+    events_drained_.Wait();
+  }
+  num_events_++;
+}
+
+// static
+void Profiler::ProcessEvents(void *arg) {
+  Profiler *profiler = static_cast<Profiler*>(arg);
+  CallEvent event;
+  int num_idle_loops = 0;
+
+  while (true) {
+    if (profiler->events_->Pop(event)) {
+      profiler->ConsumeEvent(event);
+      num_idle_loops = 0;
+      continue;
+    }
+    if (num_idle_loops == 0) {
+      // Wake up the server thread if it's waiting for the events to be
+      // processed. The event is set after the last one, so the waiter
+      // can't miss it.
+      profiler->events_drained_.Set();
+    }
+    if (profiler->stop_aggregation_) {
+      // More events may have been pushed between the Pop() above and
+      // setting the flag.
+      COMPILER_BARRIER();
+      while (profiler->events_->Pop(event)) {
+        profiler->ConsumeEvent(event);
+      }
       break;
+    } else if (num_idle_loops < kAggregationSpinCount) {
+      num_idle_loops++;
+      Thread::Sleep(0);
+    } else {
+      Thread::Sleep(1);
     }
   }
 }
 
+void Profiler::ConsumeEvent(const CallEvent &event) {
+  try {
+    ProcessEvent(event);
+  } catch (const Exception &) {
+    // The server thread's stack of pending calls is as deep as call_stack_
+    // and overflows first, so the two must have gone out of sync.
+    assert(false);
+  }
+  // Statistics must be updated before UpdateStatistics() sees the event
+  // as processed.
+  COMPILER_BARRIER();
+  num_processed_events_++;
+}
+
+void Profiler::ProcessEvent(const CallEvent &event) {
+  switch (event.type) {
+    case CallEvent::BEGIN:
+      event.fn_stats->AdjustNumCalls(1);
+      call_stack_.Push(event.fn_stats, 0, TimePoint(event.time));
+      if (call_graph_enabled_) {
+        call_graph_.AddCallee(event.fn_stats)->MakeRoot();
+      }
+      if (trace_recorder_ != 0) {
+        trace_recorder_->RecordBegin(event.fn_stats, TimePoint(event.time));
+      }
+      break;
+    case CallEvent::END:
+      assert(!call_stack_.is_empty());
+      AddCall(call_stack_.Pop(TimePoint(event.time)));
+      break;
+  }
+}
+
 } // namespace amxprof
@@ -25,31 +25,107 @@
 #ifndef AMXPROF_PROFILER_H
 #define AMXPROF_PROFILER_H
 
+#include <cstddef>
 #include <set>
+#include <vector>
 #include "amx_types.h"
 #include "call_graph.h"
 #include "call_stack.h"
 #include "debug_info.h"
 #include "function_statistics.h"
+#include "line_statistics.h"
 #include "macros.h"
+#include "ring_buffer.h"
+#include "sampler.h"
 #include "statistics.h"
+#include "string_table.h"
+#include "thread.h"
 
 namespace amxprof {
 
+class TraceRecorder;
+
 class Profiler {
  public:
   typedef std::set<Function*> FunctionSet;
 
+  static const std::size_t kDefaultEventBufferSize = 65536;
+
  public:
-  Profiler(AMX *amx, DebugInfo *debug_info = 0);
+  Profiler(AMX *amx, DebugInfo *debug_info = 0,
+           std::size_t max_call_depth = CallStack::kDefaultMaxDepth);
   ~Profiler();
 
   bool call_graph_enabled() const { return call_graph_enabled_; }
   void set_call_graph_enabled(bool enabled) { call_graph_enabled_ = enabled; }
 
+  // In async mode the call stack belongs to the aggregation thread.
   const CallStack *call_stack() const { return &call_stack_; }
   const CallGraph *call_graph() const { return &call_graph_; }
 
+  // If set, every call is also recorded to the trace. In async mode this is
+  // done by the aggregation thread. The recorder is not owned by the
+  // profiler and must outlive it.
+  TraceRecorder *trace_recorder() const { return trace_recorder_; }
+  void set_trace_recorder(TraceRecorder *recorder) {
+    trace_recorder_ = recorder;
+  }
+
+  // Measures the profiler's own overhead per function call by making a
+  // number of dummy calls through BeginFunction() and EndFunction(). It
+  // is later subtracted from reported times. This should be called before
+  // the script starts running.
+  void Calibrate();
+
+  // Switches the profiler to statistical sampling. Instead of timing every
+  // call, the running functions are recorded every interval of the server
+  // thread's CPU time and reported as sample counts and estimated time.
+  // Must be called from the server thread. Throws an Exception if sampling
+  // can't be started.
+  void StartSampling(Nanoseconds interval);
+
+  bool is_sampling() const { return sampler_ != 0; }
+  const Sampler *sampler() const { return sampler_; }
+
+  // Switches the profiler to async mode. The hooks then only record when
+  // each call begins and ends into a ring buffer, and a separate thread
+  // replays these events to update the statistics and the call graph. Must
+  // be called before any functions are profiled (including Calibrate()).
+  // Throws a SystemError if the thread can't be started.
+  void StartAsync(std::size_t buffer_size = kDefaultEventBufferSize);
+
+  bool is_async() const { return events_ != 0; }
+
+  // Makes DebugHook() record the time spent on each line of the script
+  // in line_stats(), from one BREAK instruction to the next. This is done
+  // on the server thread in any mode except sampling, where it throws an
+  // Exception.
+  void StartLineProfiling();
+
+  bool is_profiling_lines() const { return line_stats_ != 0; }
+  const LineStatistics *line_stats() const { return line_stats_; }
+
+  // Brings stats() and call_graph() up to date: adds samples collected so
+  // far, waits until the aggregation thread has processed all events and
+  // resolves the names of functions that were called for the first time.
+  // This must be done before reading them.
+  void UpdateStatistics();
+
+  // Stops profiling and undoes the changes made to the AMX. The profiler
+  // doesn't touch the AMX after that, so its results can be read and it
+  // can be deleted in another thread once the script is unloaded. The hooks
+  // must not be called after this. Must be called from the server thread.
+  void Detach();
+
+  // Returns true if the script is being executed. The calls that haven't
+  // finished yet are not included in stats(), so this is not a good moment
+  // to read them.
+  bool is_executing() const;
+
+  // Returns the number of calls that were not profiled because they were
+  // made deeper than the call stack's maximum depth.
+  unsigned long num_dropped_calls() const { return num_dropped_calls_; }
+
   // Retruns collected runtime statistics.
   const Statistics *stats() const { return &stats_;  }
 
@@ -62,23 +138,91 @@ class Profiler {
   // function calls.
   int DebugHook(AMX_DEBUG debug = 0);
 
-  // This method should be called instead of amx_Callback().
-  // It collects information about native function calls.
+  // This method should be called instead of amx_Callback(). On the first
+  // call of each native it replaces the native's entry in the native table
+  // with a thunk that calls NativeHook(); natives that can't have a thunk
+  // are profiled here.
   int CallbackHook(cell index, cell  *result, cell *params, AMX_CALLBACK callback = 0);
 
+  // Called by native thunks (see native_thunks.h). It collects information
+  // about native function calls.
+  cell NativeHook(NativeTableIndex index, cell *params);
+
+ private:
+  // A call begins or ends at the given time.
+  struct CallEvent {
+    enum Type {
+      BEGIN,
+      END
+    };
+    FunctionStatistics *fn_stats;
+    Type type;
+    Ticks time;
+  };
+
+  // A call that is on the stack in async mode, as seen by the server
+  // thread.
+  struct PendingCall {
+    FunctionStatistics *fn_stats;
+    Address frame;
+  };
+
  private:
   Profiler();
 
+  void ProcessSamples();
+
+  // Looks up the names of new normal functions in one go and records them
+  // to the trace.
+  void ResolveNames();
+
+  // Returns the statistics of the innermost running function and stores its
+  // frame address in frame, or returns 0 if nothing is running.
+  const FunctionStatistics *GetRunningFunction(Address &frame) const;
+
+  void PushEvent(FunctionStatistics *fn_stats, CallEvent::Type type,
+                 TimePoint time);
+
+  // The aggregation thread's main loop.
+  static void ProcessEvents(void *arg);
+  void ProcessEvent(const CallEvent &event);
+
+  // Processes an event popped off events_ and marks it as processed.
+  void ConsumeEvent(const CallEvent &event);
+
+  // These return statistics of the specified function, adding it to
+  // stats() on first use, or 0 if there is no such function.
+  FunctionStatistics *LookupNative(NativeTableIndex index);
+  FunctionStatistics *LookupPublic(PublicTableIndex index);
+  FunctionStatistics *LookupNormal(Address address);
+
+  // Installs the thunk for the specified native unless it's already there.
+  // Returns false if the native can't be profiled through a thunk.
+  bool InstallNativeThunk(NativeTableIndex index);
+
   // BeginFunction() and EndFunction() are called when entering a function
-  // (of either type) and returning from it respectively.
-  void BeginFunction(Address address, Address frm);
-  void EndFunction(Address address = 0);
+  // (of either type) and returning from it respectively. If fn_stats is
+  // given to EndFunction() it pops calls until that function is reached.
+  // BeginFunction() returns false and leaves the statistics alone if the
+  // call stack is full; such calls must not be ended.
+  bool BeginFunction(FunctionStatistics *fn_stats, Address frm);
+  void EndFunction(const FunctionStatistics *fn_stats = 0);
+
+  // Adds a call that has just been popped off call_stack_ to the
+  // statistics and the call graph's root, then moves the root back to its
+  // caller.
+  void AddCall(FunctionCall &fn_call);
+
+  // Charges the time since the current line started to that line and
+  // makes the given line current, or none if it's kNoLine.
+  void EnterLine(Address line, TimePoint now);
 
  private:
   AMX *amx_;
   DebugInfo *debug_info_;
 
   bool call_graph_enabled_;
+  TraceRecorder *trace_recorder_;
 
   CallStack call_stack_;
   CallGraph call_graph_;
@@ -86,6 +230,39 @@ class Profiler {
   Statistics stats_;
   FunctionSet functions_;
 
+  // Names of all functions in functions_. They are never removed, so
+  // snapshots can still refer to them.
+  StringTable names_;
+  std::vector<Function*> unnamed_functions_;
+
+  Sampler *sampler_;
+
+  // Only used in async mode. The server thread is the only producer and
+  // the aggregation thread the only consumer of events_.
+  RingBuffer<CallEvent> *events_;
+  Thread *aggregation_thread_;
+  volatile bool stop_aggregation_;
+  unsigned long num_events_;
+  volatile unsigned long num_processed_events_;
+  // Set by the aggregation thread whenever it runs out of events.
+  Event events_drained_;
+  std::vector<PendingCall> pending_calls_;
+  std::size_t num_pending_calls_;
+
+  // Original addresses of natives replaced with thunks, 0 for natives that
+  // haven't been called yet. Empty if thunks are not used.
+  std::vector<AMX_NATIVE> natives_;
+
+  // Only used when profiling lines. current_line_ is the address of the
+  // BREAK instruction of the line that is running.
+  LineStatistics *line_stats_;
+  Address current_line_;
+  TimePoint line_start_;
+
+  // Frame of the normal function that didn't fit on the call stack, or 0.
+  Address overflow_frame_;
+  unsigned long num_dropped_calls_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Profiler);
 };
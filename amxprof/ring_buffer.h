@@ -0,0 +1,129 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_RING_BUFFER_H
+#define AMXPROF_RING_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include "macros.h"
+
+#if !(defined __i386__ || defined __x86_64__ || \
+      defined _M_IX86 || defined _M_X64)
+  #error RingBuffer relies on the x86 memory model
+#endif
+
+namespace amxprof {
+
+// RingBuffer is a fixed-size single-producer/single-consumer queue. The
+// producer and the consumer may run in different threads, or the producer
+// may be a signal handler that interrupts the consumer. Neither side ever
+// blocks or allocates memory: Push() fails if the buffer is full and Pop()
+// fails if it's empty.
+//
+// The indices are ordered against the items with compiler barriers only.
+// This is enough on x86, where the CPU doesn't reorder stores with other
+// stores or loads with other loads, but not on weaker architectures.
+template<typename T>
+class RingBuffer {
+ public:
+  // The capacity is rounded up to the nearest power of two.
+  explicit RingBuffer(std::size_t capacity);
+
+  bool Push(const T &item);
+  bool Pop(T &item);
+
+  bool is_empty() const { return head_.value == tail_.value; }
+  std::size_t capacity() const { return items_.size(); }
+
+ private:
+  static const std::size_t kCacheLineSize = 64;
+
+  // The producer and the consumer each write to their own index, which are
+  // kept on separate cache lines to avoid false sharing.
+  struct Index {
+    Index() : value(0) {}
+    volatile std::size_t value;
+    char padding[kCacheLineSize - sizeof(std::size_t)];
+  };
+
+  static std::size_t RoundUpToPowerOfTwo(std::size_t n);
+
+ private:
+  Index head_;
+  Index tail_;
+  std::vector<T> items_;
+  std::size_t mask_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
+
+template<typename T>
+RingBuffer<T>::RingBuffer(std::size_t capacity)
+ : items_(RoundUpToPowerOfTwo(capacity)),
+   mask_(items_.size() - 1)
+{
+}
+
+template<typename T>
+bool RingBuffer<T>::Push(const T &item) {
+  std::size_t head = head_.value;
+  if (head - tail_.value == items_.size()) {
+    return false;
+  }
+  items_[head & mask_] = item;
+  // The item must be written before it's made visible to the consumer.
+  COMPILER_BARRIER();
+  head_.value = head + 1;
+  return true;
+}
+
+template<typename T>
+bool RingBuffer<T>::Pop(T &item) {
+  std::size_t tail = tail_.value;
+  if (tail == head_.value) {
+    return false;
+  }
+  COMPILER_BARRIER();
+  item = items_[tail & mask_];
+  // The item must be read before its slot is handed back to the producer.
+  COMPILER_BARRIER();
+  tail_.value = tail + 1;
+  return true;
+}
+
+// static
+template<typename T>
+std::size_t RingBuffer<T>::RoundUpToPowerOfTwo(std::size_t n) {
+  std::size_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace amxprof
+
+#endif // !AMXPROF_RING_BUFFER_H
@@ -0,0 +1,70 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "amx_utils.h"
+#include "sampler.h"
+
+namespace amxprof {
+
+Sampler::Sampler(AMX *amx, Nanoseconds interval, std::size_t buffer_size)
+ : amx_(amx),
+   interval_(interval),
+   timer_(0),
+   current_public_(kNoIndex),
+   current_native_(kNoIndex),
+   num_dropped_samples_(0),
+   samples_(buffer_size)
+{
+}
+
+Sampler::~Sampler() {
+  Stop();
+}
+
+void Sampler::TakeSample() {
+  if (current_public_ == kNoIndex) {
+    return;
+  }
+
+  Sample sample;
+  sample.public_index = current_public_;
+  sample.native_index = current_native_;
+  sample.num_frames = 0;
+
+  Address frame = amx_->frm;
+  while (sample.num_frames < kMaxFrames) {
+    Address address = GetCalleeAddress(amx_, frame);
+    if (address == 0) {
+      break;
+    }
+    sample.frames[sample.num_frames++] = address;
+    frame = GetCallerFrame(amx_, frame);
+  }
+
+  if (!samples_.Push(sample)) {
+    num_dropped_samples_++;
+  }
+}
+
+} // namespace amxprof
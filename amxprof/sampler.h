@@ -0,0 +1,108 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_SAMPLER_H
+#define AMXPROF_SAMPLER_H
+
+#include <climits>
+#include <cstddef>
+#include "amx_types.h"
+#include "duration.h"
+#include "macros.h"
+#include "ring_buffer.h"
+
+namespace amxprof {
+
+// Sampler periodically interrupts the thread that started it and records
+// what the AMX is currently executing: the innermost native, a short chain
+// of normal functions walked from amx->frm and the public at the bottom.
+// Samples are queued into a ring buffer and should be regularly drained
+// with PopSample().
+//
+// Note that the AMX only updates amx->frm on BREAK instructions and native
+// calls, so the debug hook must be kept installed for samples to be
+// accurate.
+class Sampler {
+ public:
+  static const TableIndex kNoIndex = INT_MIN;
+  static const int kMaxFrames = 16;
+  static const std::size_t kDefaultBufferSize = 4096;
+
+  struct Sample {
+    PublicTableIndex public_index;
+    NativeTableIndex native_index;
+    int num_frames;
+    // Addresses of the running normal functions, innermost first.
+    Address frames[kMaxFrames];
+  };
+
+  Sampler(AMX *amx, Nanoseconds interval,
+          std::size_t buffer_size = kDefaultBufferSize);
+  ~Sampler();
+
+  // Start() must be called from the thread running the AMX. Both throw
+  // an Exception on failure.
+  void Start();
+  void Stop();
+
+  bool is_running() const { return timer_ != 0; }
+
+  Nanoseconds interval() const { return interval_; }
+
+  // The public and the native function that the AMX is currently
+  // executing, or kNoIndex if none.
+  PublicTableIndex current_public() const { return current_public_; }
+  void set_current_public(PublicTableIndex index) { current_public_ = index; }
+
+  NativeTableIndex current_native() const { return current_native_; }
+  void set_current_native(NativeTableIndex index) { current_native_ = index; }
+
+  // Records a sample. This is called from the timer's signal handler.
+  void TakeSample();
+
+  bool PopSample(Sample &sample) { return samples_.Pop(sample); }
+
+  // Returns the number of samples lost because the buffer was full.
+  long num_dropped_samples() const { return num_dropped_samples_; }
+
+ private:
+  // Platform-specific timer data.
+  class Timer;
+
+ private:
+  AMX *amx_;
+  Nanoseconds interval_;
+  Timer *timer_;
+  volatile PublicTableIndex current_public_;
+  volatile NativeTableIndex current_native_;
+  volatile long num_dropped_samples_;
+  RingBuffer<Sample> samples_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Sampler);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_SAMPLER_H
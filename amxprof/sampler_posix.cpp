@@ -0,0 +1,160 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "exception.h"
+#include "sampler.h"
+#include "stdint.h"
+#include "system_error.h"
+
+#if !defined sigev_notify_thread_id
+  #define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace amxprof {
+
+namespace {
+
+// Samplers that may currently receive signals. A signal can still arrive
+// after its timer is deleted, so the handler ignores unknown samplers.
+const int kMaxSamplers = 32;
+Sampler *volatile samplers[kMaxSamplers];
+
+void HandleSignal(int /*signo*/, siginfo_t *info, void * /*context*/) {
+  Sampler *sampler = static_cast<Sampler*>(info->si_value.sival_ptr);
+  if (sampler == 0) {
+    return;
+  }
+  for (int i = 0; i < kMaxSamplers; i++) {
+    if (samplers[i] == sampler) {
+      sampler->TakeSample();
+      break;
+    }
+  }
+}
+
+void InstallSignalHandler() {
+  static bool installed = false;
+  if (!installed) {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = HandleSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, 0) == -1) {
+      throw SystemError("sigaction");
+    }
+    installed = true;
+  }
+}
+
+void RegisterSampler(Sampler *sampler) {
+  for (int i = 0; i < kMaxSamplers; i++) {
+    if (samplers[i] == 0) {
+      samplers[i] = sampler;
+      return;
+    }
+  }
+  throw Exception("Too many samplers");
+}
+
+void UnregisterSampler(Sampler *sampler) {
+  for (int i = 0; i < kMaxSamplers; i++) {
+    if (samplers[i] == sampler) {
+      samplers[i] = 0;
+    }
+  }
+}
+
+} // anonymous namespace
+
+class Sampler::Timer {
+ public:
+  timer_t id;
+};
+
+void Sampler::Start() {
+  if (timer_ != 0) {
+    return;
+  }
+
+  InstallSignalHandler();
+  RegisterSampler(this);
+
+  // Deliver signals to the current thread only and count its CPU time,
+  // so that the server's other threads are never interrupted and idle
+  // time between ticks is not sampled.
+  struct sigevent event;
+  std::memset(&event, 0, sizeof(event));
+  event.sigev_signo = SIGPROF;
+  event.sigev_value.sival_ptr = this;
+  #if defined SIGEV_THREAD_ID
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_notify_thread_id = syscall(SYS_gettid);
+  #else
+    event.sigev_notify = SIGEV_SIGNAL;
+  #endif
+
+  Timer *timer = new Timer;
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer->id) == -1) {
+    int error = errno;
+    UnregisterSampler(this);
+    delete timer;
+    throw SystemError("timer_create", error);
+  }
+
+  // Split before narrowing, long is 32-bit on x86.
+  int64_t ns = static_cast<int64_t>(interval_.count());
+  struct itimerspec spec;
+  spec.it_interval.tv_sec = static_cast<time_t>(ns / 1000000000);
+  spec.it_interval.tv_nsec = static_cast<long>(ns % 1000000000);
+  spec.it_value = spec.it_interval;
+
+  if (timer_settime(timer->id, 0, &spec, 0) == -1) {
+    int error = errno;
+    timer_delete(timer->id);
+    UnregisterSampler(this);
+    delete timer;
+    throw SystemError("timer_settime", error);
+  }
+
+  timer_ = timer;
+}
+
+void Sampler::Stop() {
+  if (timer_ == 0) {
+    return;
+  }
+  UnregisterSampler(this);
+  timer_delete(timer_->id);
+  delete timer_;
+  timer_ = 0;
+}
+
+} // namespace amxprof
@@ -22,50 +22,209 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
+#include <cassert>
 #include "function.h"
 #include "function_statistics.h"
 #include "statistics.h"
 
 namespace amxprof {
 
-Statistics::Statistics() {
+namespace {
+
+// Initial capacity of the address index, must be a power of two.
+const std::size_t kAddressIndexInitialSize = 256;
+
+inline std::size_t HashAddress(Address address) {
+  // Function addresses are always cell-aligned so the lowest bits carry
+  // no information.
+  return static_cast<std::size_t>(address) / sizeof(cell);
+}
+
+bool CompareAddresses(const FunctionStatistics *lhs,
+                      const FunctionStatistics *rhs) {
+  return lhs->function()->address() < rhs->function()->address();
+}
+
+template<typename Container>
+void DeleteAll(const Container &container) {
+  for (typename Container::const_iterator iterator = container.begin();
+       iterator != container.end(); ++iterator) {
+    delete *iterator;
+  }
+}
+
+} // anonymous namespace
+
+Statistics::Statistics(int num_natives, int num_publics)
+ : is_copy_(false),
+   copy_run_time_(0),
+   sampled_(false),
+   native_fn_stats_(num_natives),
+   public_fn_stats_(num_publics + 1),
+   address_index_(kAddressIndexInitialSize),
+   address_index_count_(0)
+{
   run_time_counter_.Start();
 }
 
 Statistics::~Statistics() {
-  for (AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.begin();
-       iterator != address_to_fn_stats_.end(); ++iterator)
-  {
-    delete iterator->second;
+  DeleteAll(native_fn_stats_);
+  DeleteAll(public_fn_stats_);
+  DeleteAll(normal_fn_stats_);
+}
+
+FunctionStatistics *Statistics::GetStatisticsByAddress(Address address) const {
+  assert(address != 0);
+  std::size_t mask = address_index_.size() - 1;
+  for (std::size_t i = HashAddress(address) & mask; ; i = (i + 1) & mask) {
+    const AddressIndexEntry &entry = address_index_[i];
+    if (entry.address == address) {
+      return entry.fn_stats;
+    }
+    if (entry.address == 0) {
+      return 0;
+    }
   }
 }
 
-Function *Statistics::GetFunction(Address address) {
-  AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.find(address);
-  if (iterator != address_to_fn_stats_.end()) {
-    return iterator->second->function();
+FunctionStatistics *Statistics::GetStatisticsById(int id) const {
+  assert(id >= 0);
+  std::size_t index = static_cast<std::size_t>(id);
+  if (index < native_fn_stats_.size()) {
+    return native_fn_stats_[index];
+  }
+  index -= native_fn_stats_.size();
+  if (index < public_fn_stats_.size()) {
+    return public_fn_stats_[index];
+  }
+  index -= public_fn_stats_.size();
+  if (index < normal_fn_stats_.size()) {
+    return normal_fn_stats_[index];
   }
   return 0;
 }
 
-void Statistics::AddFunction(Function *fn) {
-  FunctionStatistics *fn_stats = new FunctionStatistics(fn);
-  address_to_fn_stats_.insert(std::make_pair(fn->address(), fn_stats));
+FunctionStatistics *Statistics::AddNative(NativeTableIndex index,
+                                          Function *fn) {
+  assert(index >= 0 && index < num_natives());
+  assert(native_fn_stats_[index] == 0);
+  return native_fn_stats_[index] = new FunctionStatistics(fn, index);
+}
+
+FunctionStatistics *Statistics::AddPublic(PublicTableIndex index,
+                                          Function *fn) {
+  assert(index >= AMX_EXEC_MAIN && index < num_publics());
+  assert(public_fn_stats_[index + 1] == 0);
+  FunctionStatistics *fn_stats =
+    new FunctionStatistics(fn, num_natives() + index + 1);
+  public_fn_stats_[index + 1] = fn_stats;
+  // Publics may also be called directly from within the script.
+  AddToAddressIndex(fn_stats);
+  return fn_stats;
+}
+
+FunctionStatistics *Statistics::AddNormal(Function *fn) {
+  int id = static_cast<int>(native_fn_stats_.size() + public_fn_stats_.size()
+                            + normal_fn_stats_.size());
+  FunctionStatistics *fn_stats = new FunctionStatistics(fn, id);
+  normal_fn_stats_.push_back(fn_stats);
+  AddToAddressIndex(fn_stats);
+  return fn_stats;
 }
 
-FunctionStatistics *Statistics::GetFunctionStatistis(Address address) const {
-  AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.find(address);
-  if (iterator != address_to_fn_stats_.end()) {
-    return iterator->second;
+void Statistics::CopyTo(Statistics *stats) const {
+  assert(stats != this);
+  assert(stats->num_natives() == num_natives());
+  assert(stats->num_publics() == num_publics());
+
+  stats->CopyTable(native_fn_stats_, stats->native_fn_stats_);
+  stats->CopyTable(public_fn_stats_, stats->public_fn_stats_);
+  stats->CopyTable(normal_fn_stats_, stats->normal_fn_stats_);
+
+  stats->is_copy_ = true;
+  stats->copy_run_time_ = is_copy_ ? copy_run_time_
+                                   : run_time_counter_.QueryTotalTime();
+  stats->sampled_ = sampled_;
+  stats->overhead_ = overhead_;
+}
+
+void Statistics::CopyTable(const FuncStatsTable &from, FuncStatsTable &to) {
+  if (to.size() < from.size()) {
+    to.resize(from.size(), 0);
+  }
+  for (std::size_t i = 0; i < from.size(); i++) {
+    if (from[i] == 0) {
+      continue;
+    }
+    if (to[i] == 0) {
+      to[i] = new FunctionStatistics(*from[i]);
+      if (to[i]->function()->type() != Function::NATIVE) {
+        AddToAddressIndex(to[i]);
+      }
+    } else {
+      *to[i] = *from[i];
+    }
+    to[i]->set_active_call(0);
+  }
+}
+
+Nanoseconds Statistics::GetTotalRunTime() const {
+  Ticks run_time = is_copy_ ? copy_run_time_
+                            : run_time_counter_.QueryTotalTime();
+  return Clock::ToNanoseconds(run_time);
+}
+
+void Statistics::AddToAddressIndex(FunctionStatistics *fn_stats) {
+  Address address = fn_stats->function()->address();
+  if (address == 0 || GetStatisticsByAddress(address) != 0) {
+    return;
+  }
+  // Keep the load factor below 1/2 so that probe sequences stay short.
+  if ((address_index_count_ + 1) * 2 > address_index_.size()) {
+    GrowAddressIndex();
+  }
+  InsertAddressIndex(fn_stats);
+  address_index_count_++;
+}
+
+void Statistics::InsertAddressIndex(FunctionStatistics *fn_stats) {
+  Address address = fn_stats->function()->address();
+  std::size_t mask = address_index_.size() - 1;
+  std::size_t i = HashAddress(address) & mask;
+  while (address_index_[i].address != 0) {
+    i = (i + 1) & mask;
+  }
+  address_index_[i].address = address;
+  address_index_[i].fn_stats = fn_stats;
+}
+
+void Statistics::GrowAddressIndex() {
+  AddressIndex old_index(address_index_.size() * 2);
+  old_index.swap(address_index_);
+  for (AddressIndex::const_iterator iterator = old_index.begin();
+       iterator != old_index.end(); ++iterator) {
+    if (iterator->address != 0) {
+      InsertAddressIndex(iterator->fn_stats);
+    }
   }
-  return 0;
 }
 
 void Statistics::GetStatistics(std::vector<FunctionStatistics*> &stats) const {
-  for (AddressToFuncStatsMap::const_iterator iterator = address_to_fn_stats_.begin();
-       iterator != address_to_fn_stats_.end(); ++iterator) {
-    stats.push_back(iterator->second);
+  const FuncStatsTable *tables[] = {
+    &native_fn_stats_,
+    &public_fn_stats_,
+    &normal_fn_stats_
+  };
+  for (std::size_t i = 0; i < sizeof(tables) / sizeof(*tables); i++) {
+    for (FuncStatsTable::const_iterator iterator = tables[i]->begin();
+         iterator != tables[i]->end(); ++iterator) {
+      if (*iterator != 0) {
+        stats.push_back(*iterator);
+      }
+    }
   }
+  std::sort(stats.begin(), stats.end(), CompareAddresses);
 }
 
 } // namespace amxprof
@@ -25,37 +25,106 @@
 #ifndef AMXPROF_STATISTICS_H
 #define AMXPROF_STATISTICS_H
 
-#include <map>
 #include <vector>
 #include "amx_types.h"
+#include "clock.h"
 #include "duration.h"
+#include "function_statistics.h"
+#include "macros.h"
 #include "performance_counter.h"
 
 namespace amxprof {
 
 class Function;
-class FunctionStatistics;
 
+// Statistics keeps a flat table of per-function statistics. Natives and
+// publics are addressed directly by their table index while normal
+// functions are assigned dense IDs in the order they are discovered.
+// Normal and public functions can also be found by their code address
+// through a small open-addressing hash table.
 class Statistics {
  public:
-  typedef std::map<Address, FunctionStatistics*> AddressToFuncStatsMap;
+  typedef std::vector<FunctionStatistics*> FuncStatsTable;
 
-  Statistics();
+  Statistics(int num_natives = 0, int num_publics = 0);
   ~Statistics();
 
-  void AddFunction(Function *fn);
-  Function *GetFunction(Address address);
+  // These return 0 if the function has not been added yet.
+  FunctionStatistics *GetNativeStatistics(NativeTableIndex index) const {
+    return native_fn_stats_[index];
+  }
+  FunctionStatistics *GetPublicStatistics(PublicTableIndex index) const {
+    // Slot 0 is reserved for main() (AMX_EXEC_MAIN).
+    return public_fn_stats_[index + 1];
+  }
+  FunctionStatistics *GetStatisticsByAddress(Address address) const;
 
-  FunctionStatistics *GetFunctionStatistis(Address address) const;
-  void GetStatistics(std::vector<FunctionStatistics*> &stats) const;
+  // IDs number natives, publics and normal functions in this order. They
+  // are the same in copies made with CopyTo().
+  FunctionStatistics *GetStatisticsById(int id) const;
 
-  Nanoseconds GetTotalRunTime() const {
-    return run_time_counter_.QueryTotalTime();
+  int num_natives() const {
+    return static_cast<int>(native_fn_stats_.size());
   }
+  int num_publics() const {
+    return static_cast<int>(public_fn_stats_.size()) - 1;
+  }
+
+  FunctionStatistics *AddNative(NativeTableIndex index, Function *fn);
+  FunctionStatistics *AddPublic(PublicTableIndex index, Function *fn);
+  FunctionStatistics *AddNormal(Function *fn);
+
+  // Makes stats a copy of these statistics, reusing its FunctionStatistics
+  // objects when possible. Both must have the same number of natives and
+  // publics. The copy refers to the same Function objects and its run time
+  // stops advancing. This is much faster than writing the statistics out,
+  // so it can be done on the server thread while the copy is written
+  // elsewhere.
+  void CopyTo(Statistics *stats) const;
+
+  // Fills the vector with statistics of all known functions sorted by
+  // function address.
+  void GetStatistics(std::vector<FunctionStatistics*> &stats) const;
+
+  Nanoseconds GetTotalRunTime() const;
+
+  // Whether the statistics come from sampling rather than from timing
+  // every call. In that case the number of calls of a function is the
+  // number of samples in which it was running.
+  bool is_sampled() const { return sampled_; }
+  void set_sampled(bool sampled) { sampled_ = sampled; }
+
+  const Overhead &overhead() const { return overhead_; }
+  void set_overhead(const Overhead &overhead) { overhead_ = overhead; }
+
+ private:
+  struct AddressIndexEntry {
+    Address address;
+    FunctionStatistics *fn_stats;
+  };
+
+  typedef std::vector<AddressIndexEntry> AddressIndex;
+
+  void CopyTable(const FuncStatsTable &from, FuncStatsTable &to);
+
+  void AddToAddressIndex(FunctionStatistics *fn_stats);
+  void InsertAddressIndex(FunctionStatistics *fn_stats);
+  void GrowAddressIndex();
 
  private:
   PerformanceCounter run_time_counter_;
-  AddressToFuncStatsMap address_to_fn_stats_;
+  bool is_copy_;
+  Ticks copy_run_time_;
+  bool sampled_;
+  Overhead overhead_;
+  FuncStatsTable native_fn_stats_;
+  FuncStatsTable public_fn_stats_;
+  FuncStatsTable normal_fn_stats_;
+  AddressIndex address_index_;
+  std::size_t address_index_count_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Statistics);
 };
 
 } // namespace amxprof
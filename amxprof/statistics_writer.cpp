@@ -29,6 +29,14 @@
 
 namespace amxprof {
 
+const double StatisticsWriter::kPercentiles[] = {
+  50, 90, 99, 99.9
+};
+
+const char *const StatisticsWriter::kPercentileNames[] = {
+  "p50", "p90", "p99", "p99.9"
+};
+
 StatisticsWriter::StatisticsWriter()
  : stream_(0),
    print_date_(false),
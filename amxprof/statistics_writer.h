@@ -34,6 +34,12 @@ class Statistics;
 
 class StatisticsWriter {
  public:
+  // Percentiles of call times reported in addition to the average and the
+  // worst time.
+  static const int kNumPercentiles = 4;
+  static const double kPercentiles[kNumPercentiles];
+  static const char *const kPercentileNames[kNumPercentiles];
+
   StatisticsWriter();
   virtual ~StatisticsWriter();
 
@@ -24,9 +24,11 @@
 
 #include <iomanip>
 #include <iostream>
+#include "clock.h"
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "histogram.h"
 #include "statistics_writer_html.h"
 #include "performance_counter.h"
 #include "statistics.h"
@@ -34,6 +36,14 @@
 
 namespace amxprof {
 
+void StatisticsWriterHtml::DoPercentiles(const Histogram &histogram) {
+  for (int i = 0; i < kNumPercentiles; i++) {
+    Ticks value = histogram.GetValueAtPercentile(kPercentiles[i]);
+    *stream() << "      <td>" << std::setprecision(3)
+              << Milliseconds(Clock::ToNanoseconds(value)).count() << "</td>\n";
+  }
+}
+
 void StatisticsWriterHtml::Write(const Statistics *stats)
 {
   *stream() <<
@@ -116,6 +126,18 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
     ;
   }
 
+  const Overhead &overhead = stats->overhead();
+  *stream() <<
+  "      <tr>\n"
+  "        <td>Overhead per call</td>\n"
+  "        <td>" << Clock::ToNanoseconds(overhead.call_time).count() << " ns</td>\n"
+  "      </tr>\n"
+  "      <tr>\n"
+  "        <td>Overhead per child call</td>\n"
+  "        <td>" << Clock::ToNanoseconds(overhead.child_time).count() << " ns</td>\n"
+  "      </tr>\n"
+  ;
+
   *stream() <<
   "    </tbody>\n"
   "  </table>\n"
@@ -125,19 +147,27 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
   "      <tr>\n"
   "        <th rowspan=\"2\">Type</th>\n"
   "        <th rowspan=\"2\">Name</th>\n"
-  "        <th rowspan=\"2\">Calls</th>\n"
-  "        <th colspan=\"4\" class=\"group\">Self Time</th>\n"
-  "        <th colspan=\"4\" class=\"group\">Total Time</th>\n"
+  "        <th rowspan=\"2\">" << (stats->is_sampled() ? "Samples" : "Calls") << "</th>\n"
+  "        <th colspan=\"" << 5 + kNumPercentiles << "\" class=\"group\">Self Time</th>\n"
+  "        <th colspan=\"" << 5 + kNumPercentiles << "\" class=\"group\">Total Time</th>\n"
   "      </tr>\n"
   "      <tr>\n"
-  "        <th>%</th>\n"
-  "        <th>Overall</th>\n"
-  "        <th>Average</th>\n"
-  "        <th>Worst</th>\n"
-  "        <th>%</th>\n"
-  "        <th>Overall</th>\n"
-  "        <th>Average</th>\n"
-  "        <th>Worst</th>\n"
+  ;
+
+  for (int i = 0; i < 2; i++) {
+    *stream() <<
+    "        <th>%</th>\n"
+    "        <th>Overall</th>\n"
+    "        <th>Adjusted</th>\n"
+    "        <th>Average</th>\n"
+    "        <th>Worst</th>\n"
+    ;
+    for (int j = 0; j < kNumPercentiles; j++) {
+      *stream() << "        <th>" << kPercentileNames[j] << "</th>\n";
+    }
+  }
+
+  *stream() <<
   "      </tr>\n"
   "    </thead>\n"
   "    <tbody>\n"
@@ -146,7 +176,7 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
   std::vector<FunctionStatistics*> all_fn_stats;
   stats->GetStatistics(all_fn_stats);
 
-  Nanoseconds self_time_all;
+  Ticks self_time_all = 0;
   for (std::vector<FunctionStatistics*>::const_iterator iterator = all_fn_stats.begin();
        iterator != all_fn_stats.end(); ++iterator)
   {
@@ -154,7 +184,7 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
     self_time_all += fn_stats->self_time();
   };
 
-  Nanoseconds total_time_all;
+  Ticks total_time_all = 0;
   for (std::vector<FunctionStatistics*>::const_iterator iterator = all_fn_stats.begin();
        iterator != all_fn_stats.end(); ++iterator)
   {
@@ -170,17 +200,20 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
   {
     const FunctionStatistics *fn_stats = *iterator;
 
-    double self_time_percent = fn_stats->self_time().count() * 100 / self_time_all.count();
-    double total_time_percent = fn_stats->total_time().count() * 100 / total_time_all.count();
+    double self_time_percent = static_cast<double>(fn_stats->self_time()) * 100 / self_time_all;
+    double total_time_percent = static_cast<double>(fn_stats->total_time()) * 100 / total_time_all;
+
+    double self_time = Seconds(Clock::ToNanoseconds(fn_stats->self_time())).count();
+    double total_time = Seconds(Clock::ToNanoseconds(fn_stats->total_time())).count();
 
-    double self_time = Seconds(fn_stats->self_time()).count();
-    double total_time = Seconds(fn_stats->total_time()).count();
+    double adj_self_time = Seconds(Clock::ToNanoseconds(fn_stats->GetAdjustedSelfTime(overhead))).count();
+    double adj_total_time = Seconds(Clock::ToNanoseconds(fn_stats->GetAdjustedTotalTime(overhead))).count();
 
-    double avg_self_time = Milliseconds(fn_stats->self_time()).count() / fn_stats->num_calls();
-    double avg_total_time = Milliseconds(fn_stats->total_time()).count() / fn_stats->num_calls();
+    double avg_self_time = Milliseconds(Clock::ToNanoseconds(fn_stats->self_time())).count() / fn_stats->num_calls();
+    double avg_total_time = Milliseconds(Clock::ToNanoseconds(fn_stats->total_time())).count() / fn_stats->num_calls();
 
-    double worst_self_time = Milliseconds(fn_stats->worst_self_time()).count();
-    double worst_total_time = Milliseconds(fn_stats->worst_total_time()).count();
+    double worst_self_time = Milliseconds(Clock::ToNanoseconds(fn_stats->worst_self_time())).count();
+    double worst_total_time = Milliseconds(Clock::ToNanoseconds(fn_stats->worst_total_time())).count();
 
     *stream()
     << "    <tr>\n"
@@ -189,12 +222,18 @@ void StatisticsWriterHtml::Write(const Statistics *stats)
     << "      <td>" << fn_stats->num_calls() << "</td>\n"
     << "      <td>" << std::setprecision(2) << self_time_percent << "%</td>\n"
     << "      <td>" << std::setprecision(1) << self_time << "</td>\n"
+    << "      <td>" << std::setprecision(1) << adj_self_time << "</td>\n"
     << "      <td>" << std::setprecision(1) << avg_self_time << "</td>\n"
-    << "      <td>" << std::setprecision(1) << worst_self_time << "</td>\n"
+    << "      <td>" << std::setprecision(1) << worst_self_time << "</td>\n";
+    DoPercentiles(fn_stats->self_time_histogram());
+    *stream()
     << "      <td>" << std::setprecision(2) << total_time_percent << "%</td>\n"
     << "      <td>" << std::setprecision(1) << total_time << "</td>\n"
+    << "      <td>" << std::setprecision(1) << adj_total_time << "</td>\n"
     << "      <td>" << std::setprecision(1) << avg_total_time << "</td>\n"
-    << "      <td>" << std::setprecision(1) << worst_total_time << "</td>\n"
+    << "      <td>" << std::setprecision(1) << worst_total_time << "</td>\n";
+    DoPercentiles(fn_stats->total_time_histogram());
+    *stream()
     << "    </tr>\n";
   };
 
@@ -29,9 +29,13 @@
 
 namespace amxprof {
 
+class Histogram;
+
 class StatisticsWriterHtml : public StatisticsWriter {
  public:
   virtual void Write(const Statistics *stats);
+ private:
+  void DoPercentiles(const Histogram &histogram);
 };
 
 } // namespace amxprof
@@ -23,9 +23,12 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
+#include "clock.h"
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "histogram.h"
+#include "json_utils.h"
 #include "performance_counter.h"
 #include "statistics_writer_json.h"
 #include "statistics.h"
@@ -33,32 +36,20 @@
 
 namespace amxprof {
 
-static std::string EscapString(const std::string &s) {
-  std::string t;
-
-  for (std::string::const_iterator iterator = s.begin();
-       iterator != s.end(); ++iterator) {
-    switch (*iterator) {
-      // According to http://www.json.org other escape sequences,
-      // apart from Unicode, are not supported by JSON.
-      case '"': t.append("\\\""); break;
-      case '\\': t.append("\\\\"); break;
-      case '\b': t.append("\\b"); break;
-      case '\f': t.append("\\f"); break;
-      case '\n': t.append("\\n"); break;
-      case '\r': t.append("\\r"); break;
-      case '\t': t.append("\\t"); break;
-      default: t.push_back(*iterator);
-    }
+void StatisticsWriterJson::DoPercentiles(const Histogram &histogram) {
+  *stream() << "{";
+  for (int i = 0; i < kNumPercentiles; i++) {
+    Ticks value = histogram.GetValueAtPercentile(kPercentiles[i]);
+    *stream() << (i > 0 ? ", " : "") << "\"" << kPercentileNames[i] << "\": "
+              << Clock::ToNanoseconds(value).count();
   }
-
-  return t;
+  *stream() << "}";
 }
 
 void StatisticsWriterJson::Write(const Statistics *stats)
 {
   *stream() << "{\n"
-            << "  \"scriptName\": \"" << EscapString(script_name()) << "\",\n";
+            << "  \"scriptName\": \"" << EscapeJsonString(script_name()) << "\",\n";
   
   if (print_date()) {
     *stream() << "  \"timestamp\": " << TimeStamp::Now() << ",\n";
@@ -68,6 +59,12 @@ void StatisticsWriterJson::Write(const Statistics *stats)
     *stream() << "  \"runTime\": " << Seconds(stats->GetTotalRunTime()).count() << ",\n";
   }
 
+  *stream() << "  \"sampled\": " << (stats->is_sampled() ? "true" : "false") << ",\n";
+
+  const Overhead &overhead = stats->overhead();
+  *stream() << "  \"callOverhead\": " << Clock::ToNanoseconds(overhead.call_time).count() << ",\n"
+            << "  \"childCallOverhead\": " << Clock::ToNanoseconds(overhead.child_time).count() << ",\n";
+
   *stream() << "  \"functions\": [\n";
 
   std::vector<FunctionStatistics*> all_fn_stats;
@@ -77,15 +74,26 @@ void StatisticsWriterJson::Write(const Statistics *stats)
        iterator != all_fn_stats.end(); ++iterator)
   {
     const FunctionStatistics *fn_stats = *iterator;
+    StringView name = fn_stats->function()->name();
 
     *stream() << "    {\n"
       << "      \"type\": \"" << fn_stats->function()->GetTypeString() << "\",\n"
-      << "      \"name\": \"" << fn_stats->function()->name() << "\",\n"
+      << "      \"name\": \"";
+    WriteJsonString(*stream(), name.data(), name.size());
+    *stream() << "\",\n"
       << "      \"calls\": " << fn_stats->num_calls() << ",\n"
-      << "      \"selfTime\": " << fn_stats->self_time().count() << ",\n"
-      << "      \"worstSelfTime\": " << fn_stats->worst_self_time().count() << ",\n"
-      << "      \"totalTime\": " << fn_stats->total_time().count() << ",\n"
-      << "      \"worstTotalTime\": " << fn_stats->worst_total_time().count() << "\n"
+      << "      \"selfTime\": " << Clock::ToNanoseconds(fn_stats->self_time()).count() << ",\n"
+      << "      \"adjustedSelfTime\": " << Clock::ToNanoseconds(fn_stats->GetAdjustedSelfTime(overhead)).count() << ",\n"
+      << "      \"worstSelfTime\": " << Clock::ToNanoseconds(fn_stats->worst_self_time()).count() << ",\n"
+      << "      \"selfTimePercentiles\": ";
+    DoPercentiles(fn_stats->self_time_histogram());
+    *stream() << ",\n"
+      << "      \"totalTime\": " << Clock::ToNanoseconds(fn_stats->total_time()).count() << ",\n"
+      << "      \"adjustedTotalTime\": " << Clock::ToNanoseconds(fn_stats->GetAdjustedTotalTime(overhead)).count() << ",\n"
+      << "      \"worstTotalTime\": " << Clock::ToNanoseconds(fn_stats->worst_total_time()).count() << ",\n"
+      << "      \"totalTimePercentiles\": ";
+    DoPercentiles(fn_stats->total_time_histogram());
+    *stream() << "\n"
     << "    },\n";
   }
 
@@ -24,9 +24,12 @@
 
 #include <iomanip>
 #include <iostream>
+#include <string>
+#include "clock.h"
 #include "duration.h"
 #include "function.h"
 #include "function_statistics.h"
+#include "histogram.h"
 #include "performance_counter.h"
 #include "statistics_writer_text.h"
 #include "statistics.h"
@@ -37,18 +40,24 @@ static const int kNameWidth = 32;
 static const int kCallsWidth = 10;
 static const int kSelfTimePercentWidth = 15;
 static const int kSelfTimeWidth = 15;
+static const int kAdjSelfTimeWidth = 15;
 static const int kAvgSelfTimeWidth = 15;
 static const int kWorstSelfTimeWidth = 15;
 static const int kTotalTimePercentWidth = 15;
 static const int kTotalTimeWidth = 15;
+static const int kAdjTotalTimeWidth = 15;
 static const int kAvgTotalTimeWidth = 15;
 static const int kWorstTotalTimeWidth = 15;
+static const int kPercentileWidth = 15;
 
 static const int kWidthAll = kTypeWidth + kNameWidth + kCallsWidth
-  + kSelfTimePercentWidth + kSelfTimeWidth + kAvgSelfTimeWidth + kWorstSelfTimeWidth
-  + kTotalTimePercentWidth + kTotalTimeWidth + kAvgTotalTimeWidth + kWorstTotalTimeWidth;
+  + kSelfTimePercentWidth + kSelfTimeWidth + kAdjSelfTimeWidth + kAvgSelfTimeWidth
+  + kWorstSelfTimeWidth + kTotalTimePercentWidth + kTotalTimeWidth + kAdjTotalTimeWidth
+  + kAvgTotalTimeWidth + kWorstTotalTimeWidth
+  + 2 * amxprof::StatisticsWriter::kNumPercentiles * kPercentileWidth;
 
-static const int kNumColumns = 11;
+static const int kNumColumns = 13
+  + 2 * amxprof::StatisticsWriter::kNumPercentiles;
 
 namespace amxprof {
 
@@ -58,6 +67,14 @@ void StatisticsWriterText::DoHLine() {
             << std::setfill('-') << "" << std::setfill(fillch) << '\n';
 }
 
+void StatisticsWriterText::DoPercentiles(const Histogram &histogram) {
+  for (int i = 0; i < kNumPercentiles; i++) {
+    Ticks value = histogram.GetValueAtPercentile(kPercentiles[i]);
+    *stream() << "| " << std::setw(kPercentileWidth) << std::setprecision(3)
+              << Milliseconds(Clock::ToNanoseconds(value)).count();
+  }
+}
+
 void StatisticsWriterText::Write(const Statistics *stats)
 {
   *stream() << "Profile of '" << script_name() << "'";
@@ -70,26 +87,42 @@ void StatisticsWriterText::Write(const Statistics *stats)
     *stream() << " (duration: " << TimeSpan(stats->GetTotalRunTime()) << ")\n";
   }
 
+  const Overhead &overhead = stats->overhead();
+  *stream() << "Adjusted times exclude profiler overhead of "
+            << Clock::ToNanoseconds(overhead.call_time).count() << " ns per call and "
+            << Clock::ToNanoseconds(overhead.child_time).count() << " ns per child call\n";
+
   DoHLine();
   *stream() << std::left
     << "| " << std::setw(kTypeWidth) << "Type"
     << "| " << std::setw(kNameWidth) << "Name"
-    << "| " << std::setw(kCallsWidth) << "Calls"
+    << "| " << std::setw(kCallsWidth) << (stats->is_sampled() ? "Samples" : "Calls")
     << "| " << std::setw(kSelfTimePercentWidth) << "Self Time (%)"
     << "| " << std::setw(kSelfTimeWidth) << "Self Time (s)"
+    << "| " << std::setw(kAdjSelfTimeWidth) << "Adj. ST (s)"
     << "| " << std::setw(kAvgSelfTimeWidth) << "Avg. ST (ms)"
-    << "| " << std::setw(kWorstSelfTimeWidth) << "Worst ST (ms)"
+    << "| " << std::setw(kWorstSelfTimeWidth) << "Worst ST (ms)";
+  for (int i = 0; i < kNumPercentiles; i++) {
+    *stream() << "| " << std::setw(kPercentileWidth)
+              << (std::string("ST ") + kPercentileNames[i] + " (ms)");
+  }
+  *stream()
     << "| " << std::setw(kTotalTimePercentWidth) << "Total Time (%)"
     << "| " << std::setw(kTotalTimeWidth) << "Total Time (s)"
+    << "| " << std::setw(kAdjTotalTimeWidth) << "Adj. TT (s)"
     << "| " << std::setw(kAvgTotalTimeWidth) << "Avg. TT (ms)"
-    << "| " << std::setw(kWorstTotalTimeWidth) << "Worst TT (ms)"
-    << "|\n";
+    << "| " << std::setw(kWorstTotalTimeWidth) << "Worst TT (ms)";
+  for (int i = 0; i < kNumPercentiles; i++) {
+    *stream() << "| " << std::setw(kPercentileWidth)
+              << (std::string("TT ") + kPercentileNames[i] + " (ms)");
+  }
+  *stream() << "|\n";
   DoHLine();
 
   std::vector<FunctionStatistics*> all_fn_stats;
   stats->GetStatistics(all_fn_stats);
 
-  Nanoseconds self_time_all;
+  Ticks self_time_all = 0;
   for (std::vector<FunctionStatistics*>::const_iterator iterator = all_fn_stats.begin();
        iterator != all_fn_stats.end(); ++iterator)
   {
@@ -97,7 +130,7 @@ void StatisticsWriterText::Write(const Statistics *stats)
     self_time_all += fn_stats->self_time(); 
   }
 
-  Nanoseconds total_time_all;
+  Ticks total_time_all = 0;
   for (std::vector<FunctionStatistics*>::const_iterator iterator = all_fn_stats.begin();
        iterator != all_fn_stats.end(); ++iterator)
   {
@@ -113,17 +146,20 @@ void StatisticsWriterText::Write(const Statistics *stats)
   {
     const FunctionStatistics *fn_stats = *iterator;
 
-    double self_time_percent = fn_stats->self_time().count() * 100 / self_time_all.count();
-    double total_time_percent = fn_stats->total_time().count() * 100 / total_time_all.count();
+    double self_time_percent = static_cast<double>(fn_stats->self_time()) * 100 / self_time_all;
+    double total_time_percent = static_cast<double>(fn_stats->total_time()) * 100 / total_time_all;
 
-    double self_time = Seconds(fn_stats->self_time()).count();
-    double total_time = Seconds(fn_stats->total_time()).count();
+    double self_time = Seconds(Clock::ToNanoseconds(fn_stats->self_time())).count();
+    double total_time = Seconds(Clock::ToNanoseconds(fn_stats->total_time())).count();
 
-    double avg_self_time = Milliseconds(fn_stats->self_time()).count() / fn_stats->num_calls();
-    double avg_total_time = Milliseconds(fn_stats->total_time()).count() / fn_stats->num_calls();
+    double adj_self_time = Seconds(Clock::ToNanoseconds(fn_stats->GetAdjustedSelfTime(overhead))).count();
+    double adj_total_time = Seconds(Clock::ToNanoseconds(fn_stats->GetAdjustedTotalTime(overhead))).count();
 
-    double worst_self_time = Milliseconds(fn_stats->worst_self_time()).count();
-    double worst_total_time = Milliseconds(fn_stats->worst_total_time()).count();
+    double avg_self_time = Milliseconds(Clock::ToNanoseconds(fn_stats->self_time())).count() / fn_stats->num_calls();
+    double avg_total_time = Milliseconds(Clock::ToNanoseconds(fn_stats->total_time())).count() / fn_stats->num_calls();
+
+    double worst_self_time = Milliseconds(Clock::ToNanoseconds(fn_stats->worst_self_time())).count();
+    double worst_total_time = Milliseconds(Clock::ToNanoseconds(fn_stats->worst_total_time())).count();
 
     *stream()
       << "| " << std::setw(kTypeWidth) << fn_stats->function()->GetTypeString()
@@ -131,13 +167,18 @@ void StatisticsWriterText::Write(const Statistics *stats)
       << "| " << std::setw(kCallsWidth) << fn_stats->num_calls()
       << "| " << std::setw(kSelfTimePercentWidth) << std::setprecision(2) << self_time_percent
       << "| " << std::setw(kSelfTimeWidth) << std::setprecision(1) << self_time
+      << "| " << std::setw(kAdjSelfTimeWidth) << std::setprecision(1) << adj_self_time
       << "| " << std::setw(kAvgSelfTimeWidth) << std::setprecision(1) << avg_self_time
-      << "| " << std::setw(kWorstSelfTimeWidth) << std::setprecision(1) << worst_self_time
+      << "| " << std::setw(kWorstSelfTimeWidth) << std::setprecision(1) << worst_self_time;
+    DoPercentiles(fn_stats->self_time_histogram());
+    *stream()
       << "| " << std::setw(kTotalTimePercentWidth) << std::setprecision(2) << total_time_percent
       << "| " << std::setw(kTotalTimeWidth) << std::setprecision(1) << total_time
+      << "| " << std::setw(kAdjTotalTimeWidth) << std::setprecision(1) << adj_total_time
       << "| " << std::setw(kAvgTotalTimeWidth) << std::setprecision(1) << avg_total_time
-      << "| " << std::setw(kWorstTotalTimeWidth) << std::setprecision(1) << worst_total_time
-      << "|\n";
+      << "| " << std::setw(kWorstTotalTimeWidth) << std::setprecision(1) << worst_total_time;
+    DoPercentiles(fn_stats->total_time_histogram());
+    *stream() << "|\n";
     DoHLine();
   }
 
@@ -29,11 +29,14 @@
 
 namespace amxprof {
 
+class Histogram;
+
 class StatisticsWriterText : public StatisticsWriter {
  public:
   virtual void Write(const Statistics *stats);
  private:
   void DoHLine();
+  void DoPercentiles(const Histogram &histogram);
 };
 
 } // namespace amxprof
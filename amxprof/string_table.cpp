@@ -0,0 +1,151 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <iostream>
+#include "string_table.h"
+
+namespace amxprof {
+
+namespace {
+
+const std::size_t kIndexInitialSize = 256;
+
+} // anonymous namespace
+
+bool StringView::operator==(const StringView &other) const {
+  return size_ == other.size_ && std::memcmp(data_, other.data_, size_) == 0;
+}
+
+std::ostream &operator<<(std::ostream &stream, const StringView &s) {
+  std::streamsize size = static_cast<std::streamsize>(s.size());
+  std::streamsize padding = (stream.width() > size) ? stream.width() - size : 0;
+  bool left = ((stream.flags() & std::ios_base::adjustfield)
+               == std::ios_base::left);
+  if (!left) {
+    for (std::streamsize i = 0; i < padding; i++) {
+      stream.put(stream.fill());
+    }
+  }
+  stream.write(s.data(), size);
+  if (left) {
+    for (std::streamsize i = 0; i < padding; i++) {
+      stream.put(stream.fill());
+    }
+  }
+  stream.width(0);
+  return stream;
+}
+
+StringTable::StringTable()
+ : block_end_(0),
+   block_pos_(0),
+   index_(kIndexInitialSize, StringView(0, 0)),
+   num_strings_(0)
+{
+}
+
+StringTable::~StringTable() {
+  for (std::vector<char*>::const_iterator iterator = blocks_.begin();
+       iterator != blocks_.end(); ++iterator) {
+    delete[] *iterator;
+  }
+}
+
+StringView StringTable::Intern(const char *s) {
+  return Intern(s, std::strlen(s));
+}
+
+StringView StringTable::Intern(const char *s, std::size_t size) {
+  std::size_t mask = index_.size() - 1;
+  for (std::size_t i = Hash(s, size) & mask; ; i = (i + 1) & mask) {
+    const StringView &entry = index_[i];
+    if (entry.data() == 0) {
+      break;
+    }
+    if (entry.size() == size && std::memcmp(entry.data(), s, size) == 0) {
+      return entry;
+    }
+  }
+
+  char *data = Allocate(size + 1);
+  std::memcpy(data, s, size);
+  data[size] = '\0';
+
+  StringView view(data, size);
+  num_strings_++;
+  // Keep the load factor under 1/2.
+  if (num_strings_ * 2 > index_.size()) {
+    GrowIndex();
+  }
+  InsertIndex(view);
+  return view;
+}
+
+char *StringTable::Allocate(std::size_t size) {
+  if (static_cast<std::size_t>(block_end_ - block_pos_) < size) {
+    // Strings that don't fit into a block get a block of their own.
+    std::size_t block_size = size > kBlockSize ? size : kBlockSize;
+    char *block = new char[block_size];
+    blocks_.push_back(block);
+    block_pos_ = block;
+    block_end_ = block + block_size;
+  }
+  char *data = block_pos_;
+  block_pos_ += size;
+  return data;
+}
+
+void StringTable::InsertIndex(const StringView &s) {
+  std::size_t mask = index_.size() - 1;
+  std::size_t i = Hash(s.data(), s.size()) & mask;
+  while (index_[i].data() != 0) {
+    i = (i + 1) & mask;
+  }
+  index_[i] = s;
+}
+
+void StringTable::GrowIndex() {
+  std::vector<StringView> old_index(index_.size() * 2, StringView(0, 0));
+  old_index.swap(index_);
+  for (std::vector<StringView>::const_iterator iterator = old_index.begin();
+       iterator != old_index.end(); ++iterator) {
+    if (iterator->data() != 0) {
+      InsertIndex(*iterator);
+    }
+  }
+}
+
+// static
+std::size_t StringTable::Hash(const char *s, std::size_t size) {
+  // FNV-1a
+  std::size_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(s[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+} // namespace amxprof
@@ -0,0 +1,113 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_STRING_TABLE_H
+#define AMXPROF_STRING_TABLE_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "macros.h"
+
+namespace amxprof {
+
+// A read-only reference to a string stored in a StringTable. The string
+// is always followed by a NUL character, so data() is a valid C string.
+class StringView {
+ public:
+  StringView() : data_(""), size_(0) {}
+  StringView(const char *data, std::size_t size)
+   : data_(data),
+     size_(size)
+  {}
+
+  const char *data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  std::string ToString() const { return std::string(data_, size_); }
+
+  bool operator==(const StringView &other) const;
+  bool operator!=(const StringView &other) const {
+    return !operator==(other);
+  }
+
+ private:
+  const char *data_;
+  std::size_t size_;
+};
+
+// Writes the characters straight from the table, padded to the stream's
+// width, without making a temporary std::string.
+std::ostream &operator<<(std::ostream &stream, const StringView &s);
+
+// StringTable keeps a single copy of each string added to it. Strings are
+// packed into large blocks that are never moved or freed until the table
+// is destroyed, so the views it returns stay valid as long as the table.
+// Views that were already handed out can be read from another thread
+// while new strings are being added.
+class StringTable {
+ public:
+  static const std::size_t kBlockSize = 64 * 1024;
+
+  StringTable();
+  ~StringTable();
+
+  // Returns a view of the table's copy of the string, adding it if it's
+  // not in the table yet.
+  StringView Intern(const char *s, std::size_t size);
+  StringView Intern(const char *s);
+  StringView Intern(const std::string &s) {
+    return Intern(s.data(), s.size());
+  }
+
+  // Number of distinct strings in the table.
+  std::size_t num_strings() const { return num_strings_; }
+
+ private:
+  char *Allocate(std::size_t size);
+
+  void InsertIndex(const StringView &s);
+  void GrowIndex();
+
+  static std::size_t Hash(const char *s, std::size_t size);
+
+ private:
+  std::vector<char*> blocks_;
+  char *block_end_;
+  char *block_pos_;
+
+  // Open addressing hash table of all strings, empty entries have null
+  // data.
+  std::vector<StringView> index_;
+  std::size_t num_strings_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StringTable);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_STRING_TABLE_H
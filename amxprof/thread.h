@@ -0,0 +1,110 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_THREAD_H
+#define AMXPROF_THREAD_H
+
+#include "macros.h"
+
+namespace amxprof {
+
+// Minimal portable threading primitives. Their platform-specific data is
+// hidden behind an Impl pointer and all of them throw a SystemError if the
+// underlying object can't be created.
+
+class Mutex {
+ public:
+  Mutex();
+  ~Mutex();
+
+  void Lock();
+  void Unlock();
+
+  class ScopedLock {
+   public:
+    explicit ScopedLock(Mutex *mutex) : mutex_(mutex) { mutex_->Lock(); }
+    ~ScopedLock() { mutex_->Unlock(); }
+   private:
+    Mutex *mutex_;
+   private:
+    DISALLOW_COPY_AND_ASSIGN(ScopedLock);
+  };
+
+ private:
+  class Impl;
+  Impl *impl_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Mutex);
+};
+
+// An auto-reset event: Wait() blocks until the event is set and then
+// resets it, so each Set() wakes up at most one waiting thread.
+class Event {
+ public:
+  Event();
+  ~Event();
+
+  void Set();
+  void Wait();
+
+ private:
+  class Impl;
+  Impl *impl_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Event);
+};
+
+class Thread {
+ public:
+  typedef void (*Routine)(void *arg);
+
+  Thread(Routine routine, void *arg);
+
+  // The thread must be joined before it's destroyed.
+  ~Thread();
+
+  void Start();
+  void Join();
+
+  bool is_running() const { return impl_ != 0; }
+
+  // Suspends the calling thread. Sleep(0) only gives up the rest of its
+  // time slice.
+  static void Sleep(long milliseconds);
+
+ private:
+  class Impl;
+  Impl *impl_;
+  Routine routine_;
+  void *arg_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Thread);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_THREAD_H
@@ -0,0 +1,168 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cassert>
+#include <ctime>
+#include <pthread.h>
+#include <sched.h>
+#include "system_error.h"
+#include "thread.h"
+
+namespace amxprof {
+
+class Mutex::Impl {
+ public:
+  pthread_mutex_t mutex;
+};
+
+Mutex::Mutex()
+ : impl_(new Impl)
+{
+  int error = pthread_mutex_init(&impl_->mutex, 0);
+  if (error != 0) {
+    delete impl_;
+    throw SystemError("pthread_mutex_init", error);
+  }
+}
+
+Mutex::~Mutex() {
+  pthread_mutex_destroy(&impl_->mutex);
+  delete impl_;
+}
+
+void Mutex::Lock() {
+  pthread_mutex_lock(&impl_->mutex);
+}
+
+void Mutex::Unlock() {
+  pthread_mutex_unlock(&impl_->mutex);
+}
+
+class Event::Impl {
+ public:
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  bool is_set;
+};
+
+Event::Event()
+ : impl_(new Impl)
+{
+  impl_->is_set = false;
+  int error = pthread_mutex_init(&impl_->mutex, 0);
+  if (error != 0) {
+    delete impl_;
+    throw SystemError("pthread_mutex_init", error);
+  }
+  error = pthread_cond_init(&impl_->cond, 0);
+  if (error != 0) {
+    pthread_mutex_destroy(&impl_->mutex);
+    delete impl_;
+    throw SystemError("pthread_cond_init", error);
+  }
+}
+
+Event::~Event() {
+  pthread_cond_destroy(&impl_->cond);
+  pthread_mutex_destroy(&impl_->mutex);
+  delete impl_;
+}
+
+void Event::Set() {
+  pthread_mutex_lock(&impl_->mutex);
+  impl_->is_set = true;
+  pthread_cond_signal(&impl_->cond);
+  pthread_mutex_unlock(&impl_->mutex);
+}
+
+void Event::Wait() {
+  pthread_mutex_lock(&impl_->mutex);
+  while (!impl_->is_set) {
+    pthread_cond_wait(&impl_->cond, &impl_->mutex);
+  }
+  impl_->is_set = false;
+  pthread_mutex_unlock(&impl_->mutex);
+}
+
+class Thread::Impl {
+ public:
+  pthread_t thread;
+  Routine routine;
+  void *arg;
+
+  static void *Main(void *arg) {
+    Impl *impl = static_cast<Impl*>(arg);
+    impl->routine(impl->arg);
+    return 0;
+  }
+};
+
+Thread::Thread(Routine routine, void *arg)
+ : impl_(0),
+   routine_(routine),
+   arg_(arg)
+{
+}
+
+Thread::~Thread() {
+  assert(impl_ == 0);
+}
+
+void Thread::Start() {
+  if (impl_ != 0) {
+    return;
+  }
+  Impl *impl = new Impl;
+  impl->routine = routine_;
+  impl->arg = arg_;
+  int error = pthread_create(&impl->thread, 0, Impl::Main, impl);
+  if (error != 0) {
+    delete impl;
+    throw SystemError("pthread_create", error);
+  }
+  impl_ = impl;
+}
+
+void Thread::Join() {
+  if (impl_ == 0) {
+    return;
+  }
+  pthread_join(impl_->thread, 0);
+  delete impl_;
+  impl_ = 0;
+}
+
+// static
+void Thread::Sleep(long milliseconds) {
+  if (milliseconds <= 0) {
+    sched_yield();
+    return;
+  }
+  struct timespec ts;
+  ts.tv_sec = milliseconds / 1000;
+  ts.tv_nsec = (milliseconds % 1000) * 1000000L;
+  nanosleep(&ts, 0);
+}
+
+} // namespace amxprof
@@ -0,0 +1,141 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define WIN32_LEAN_AND_MEAN
+#include <cassert>
+#include <windows.h>
+#include "system_error.h"
+#include "thread.h"
+
+namespace amxprof {
+
+class Mutex::Impl {
+ public:
+  CRITICAL_SECTION critical_section;
+};
+
+Mutex::Mutex()
+ : impl_(new Impl)
+{
+  InitializeCriticalSection(&impl_->critical_section);
+}
+
+Mutex::~Mutex() {
+  DeleteCriticalSection(&impl_->critical_section);
+  delete impl_;
+}
+
+void Mutex::Lock() {
+  EnterCriticalSection(&impl_->critical_section);
+}
+
+void Mutex::Unlock() {
+  LeaveCriticalSection(&impl_->critical_section);
+}
+
+class Event::Impl {
+ public:
+  HANDLE event;
+};
+
+Event::Event()
+ : impl_(new Impl)
+{
+  impl_->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (impl_->event == NULL) {
+    DWORD error = GetLastError();
+    delete impl_;
+    throw SystemError("CreateEvent", error);
+  }
+}
+
+Event::~Event() {
+  CloseHandle(impl_->event);
+  delete impl_;
+}
+
+void Event::Set() {
+  SetEvent(impl_->event);
+}
+
+void Event::Wait() {
+  WaitForSingleObject(impl_->event, INFINITE);
+}
+
+class Thread::Impl {
+ public:
+  HANDLE thread;
+  Routine routine;
+  void *arg;
+
+  static DWORD WINAPI Main(LPVOID arg) {
+    Impl *impl = static_cast<Impl*>(arg);
+    impl->routine(impl->arg);
+    return 0;
+  }
+};
+
+Thread::Thread(Routine routine, void *arg)
+ : impl_(0),
+   routine_(routine),
+   arg_(arg)
+{
+}
+
+Thread::~Thread() {
+  assert(impl_ == 0);
+}
+
+void Thread::Start() {
+  if (impl_ != 0) {
+    return;
+  }
+  Impl *impl = new Impl;
+  impl->routine = routine_;
+  impl->arg = arg_;
+  impl->thread = CreateThread(NULL, 0, Impl::Main, impl, 0, NULL);
+  if (impl->thread == NULL) {
+    DWORD error = GetLastError();
+    delete impl;
+    throw SystemError("CreateThread", error);
+  }
+  impl_ = impl;
+}
+
+void Thread::Join() {
+  if (impl_ == 0) {
+    return;
+  }
+  WaitForSingleObject(impl_->thread, INFINITE);
+  CloseHandle(impl_->thread);
+  delete impl_;
+  impl_ = 0;
+}
+
+// static
+void Thread::Sleep(long milliseconds) {
+  ::Sleep(milliseconds > 0 ? static_cast<DWORD>(milliseconds) : 0);
+}
+
+} // namespace amxprof
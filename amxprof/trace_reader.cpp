@@ -0,0 +1,199 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "exception.h"
+#include "system_error.h"
+#include "trace_reader.h"
+
+namespace amxprof {
+
+namespace {
+
+// Magic, version and nanoseconds per tick.
+const long kHeaderSize = 8 + 4 + 8;
+
+} // anonymous namespace
+
+TraceReader::TraceReader(const std::string &filename,
+                         std::size_t buffer_size)
+ : file_(std::fopen(filename.c_str(), "rb")),
+   buffer_(buffer_size),
+   pos_(0),
+   size_(0),
+   ns_per_tick_(1.0),
+   last_time_(0)
+{
+  if (file_ == 0) {
+    throw SystemError(filename.c_str());
+  }
+
+  char magic[8];
+  unsigned char version[4];
+  if (!Read(magic, sizeof(magic))
+      || std::memcmp(magic, "AMXTRACE", sizeof(magic)) != 0
+      || !Read(version, sizeof(version))
+      || !Read(&ns_per_tick_, sizeof(ns_per_tick_))) {
+    std::fclose(file_);
+    throw Exception(filename + ": Not a trace file");
+  }
+
+  int version_number = version[0] | (version[1] << 8) | (version[2] << 16)
+                     | (version[3] << 24);
+  if (version_number != TraceRecorder::kVersion) {
+    std::fclose(file_);
+    throw Exception(filename + ": Unsupported trace format version");
+  }
+
+  ReadFunctions();
+}
+
+TraceReader::~TraceReader() {
+  std::fclose(file_);
+}
+
+bool TraceReader::ReadEvent(Event &event) {
+  return ReadRecord(event);
+}
+
+void TraceReader::ReadFunctions() {
+  Event event;
+  while (ReadRecord(event)) {
+    // Only the function descriptions are needed here.
+  }
+
+  std::fseek(file_, kHeaderSize, SEEK_SET);
+  pos_ = 0;
+  size_ = 0;
+  last_time_ = 0;
+}
+
+bool TraceReader::ReadRecord(Event &event) {
+  while (true) {
+    uint64_t tag;
+    if (!ReadVarint(tag)) {
+      return false;
+    }
+
+    std::size_t id = static_cast<std::size_t>(tag >> 2);
+    int type = static_cast<int>(tag & 3);
+
+    if (type == TraceRecorder::FUNCTION) {
+      unsigned char fn_type;
+      uint64_t length;
+      if (!ReadByte(fn_type) || !ReadVarint(length)) {
+        return false;
+      }
+      if (id >= functions_.size()) {
+        functions_.resize(id + 1);
+      }
+      std::string name(static_cast<std::size_t>(length), '\0');
+      if (length > 0 && !Read(&name[0], name.length())) {
+        return false;
+      }
+      FunctionInfo &info = functions_[id];
+      info.type = static_cast<Function::Type>(fn_type);
+      // Don't lose the name from a NAME record on the second pass.
+      if (!name.empty() || !info.is_defined) {
+        info.name = name;
+      }
+      info.is_defined = true;
+      continue;
+    }
+
+    if (type == TraceRecorder::NAME) {
+      uint64_t length;
+      if (!ReadVarint(length)) {
+        return false;
+      }
+      std::string name(static_cast<std::size_t>(length), '\0');
+      if (length > 0 && !Read(&name[0], name.length())) {
+        return false;
+      }
+      if (id < functions_.size()) {
+        functions_[id].name = name;
+      }
+      continue;
+    }
+
+    uint64_t delta;
+    if (!ReadVarint(delta)) {
+      return false;
+    }
+    last_time_ += static_cast<int64_t>(delta >> 1)
+                ^ -static_cast<int64_t>(delta & 1);
+
+    event.type = static_cast<TraceRecorder::RecordType>(type);
+    event.function_id = static_cast<int>(id);
+    event.time = last_time_;
+    return true;
+  }
+}
+
+const TraceReader::FunctionInfo *TraceReader::GetFunction(int id) const {
+  if (id < 0 || static_cast<std::size_t>(id) >= functions_.size()
+      || !functions_[id].is_defined) {
+    return 0;
+  }
+  return &functions_[id];
+}
+
+bool TraceReader::ReadByte(unsigned char &byte) {
+  if (pos_ == size_) {
+    size_ = std::fread(&buffer_[0], 1, buffer_.size(), file_);
+    pos_ = 0;
+    if (size_ == 0) {
+      return false;
+    }
+  }
+  byte = buffer_[pos_++];
+  return true;
+}
+
+bool TraceReader::ReadVarint(uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    unsigned char byte;
+    if (!ReadByte(byte)) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TraceReader::Read(void *data, std::size_t size) {
+  unsigned char *bytes = static_cast<unsigned char*>(data);
+  for (std::size_t i = 0; i < size; i++) {
+    if (!ReadByte(bytes[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace amxprof
@@ -0,0 +1,102 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_TRACE_READER_H
+#define AMXPROF_TRACE_READER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "function.h"
+#include "macros.h"
+#include "stdint.h"
+#include "trace_recorder.h"
+
+namespace amxprof {
+
+// TraceReader reads back a trace written by TraceRecorder one event at a
+// time, so traces of any size can be processed with little memory.
+class TraceReader {
+ public:
+  struct Event {
+    TraceRecorder::RecordType type; // BEGIN or END
+    int function_id;
+    Ticks time;
+  };
+
+  struct FunctionInfo {
+    FunctionInfo() : type(Function::NORMAL), is_defined(false) {}
+    Function::Type type;
+    std::string name;
+    bool is_defined;
+  };
+
+  // Throws an Exception if the file can't be opened or is not a trace.
+  explicit TraceReader(const std::string &filename,
+                       std::size_t buffer_size = TraceRecorder::kDefaultBufferSize);
+  ~TraceReader();
+
+  // Reads the next BEGIN or END event. Returns false at the end of the
+  // trace; a trace that was cut short in the middle of a record ends
+  // before it.
+  bool ReadEvent(Event &event);
+
+  // Returns the description of a function, or 0 if the ID is unknown.
+  // Names are recorded after the functions are first called, so all
+  // functions are read when the trace is opened. The name is empty if the
+  // trace ended before it was recorded.
+  const FunctionInfo *GetFunction(int id) const;
+
+  double ns_per_tick() const { return ns_per_tick_; }
+
+ private:
+  // Reads records up to the next event, function descriptions are stored
+  // in functions_.
+  bool ReadRecord(Event &event);
+
+  // Reads all function descriptions and goes back to the first record.
+  void ReadFunctions();
+
+  bool ReadByte(unsigned char &byte);
+  bool ReadVarint(uint64_t &value);
+  bool Read(void *data, std::size_t size);
+
+ private:
+  std::FILE *file_;
+  std::vector<unsigned char> buffer_;
+  std::size_t pos_;
+  std::size_t size_;
+  double ns_per_tick_;
+  Ticks last_time_;
+  std::vector<FunctionInfo> functions_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TraceReader);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_TRACE_READER_H
@@ -0,0 +1,142 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "function.h"
+#include "statistics.h"
+#include "system_error.h"
+#include "trace_recorder.h"
+
+namespace amxprof {
+
+TraceRecorder::TraceRecorder(const std::string &filename,
+                             std::size_t buffer_size)
+ : file_(std::fopen(filename.c_str(), "wb")),
+   buffer_(buffer_size),
+   size_(0),
+   last_time_(0),
+   num_events_(0),
+   has_error_(false)
+{
+  if (file_ == 0) {
+    throw SystemError(filename.c_str());
+  }
+
+  Write("AMXTRACE", 8);
+
+  unsigned char version[4];
+  for (int i = 0; i < 4; i++) {
+    version[i] = static_cast<unsigned char>((kVersion >> (i * 8)) & 0xFF);
+  }
+  Write(version, sizeof(version));
+
+  // The profiler only runs on x86, which is little-endian.
+  double ns_per_tick = Clock::ToNanoseconds(1).count();
+  Write(&ns_per_tick, sizeof(ns_per_tick));
+}
+
+TraceRecorder::~TraceRecorder() {
+  Flush();
+  std::fclose(file_);
+}
+
+void TraceRecorder::Flush() {
+  if (size_ > 0 && !has_error_) {
+    if (std::fwrite(&buffer_[0], 1, size_, file_) != size_) {
+      has_error_ = true;
+    }
+  }
+  size_ = 0;
+}
+
+void TraceRecorder::DefineFunction(const FunctionStatistics *fn_stats) {
+  std::size_t id = static_cast<std::size_t>(fn_stats->id());
+  if (id >= defined_.size()) {
+    defined_.resize(id + 1, false);
+  }
+  defined_[id] = true;
+
+  const Function *fn = fn_stats->function();
+  StringView name = fn->name();
+  if (name.empty()) {
+    unnamed_.push_back(id);
+  }
+
+  // The ID, the type and the name length.
+  if (buffer_.size() - size_ < kMaxEventSize + 1) {
+    Flush();
+  }
+  WriteVarint((static_cast<uint64_t>(id) << 2) | FUNCTION);
+  buffer_[size_++] = static_cast<char>(fn->type());
+  WriteVarint(name.size());
+  Write(name.data(), name.size());
+}
+
+void TraceRecorder::RecordNames(const Statistics *stats) {
+  if (has_error_) {
+    return;
+  }
+  std::vector<std::size_t> unnamed;
+  for (std::vector<std::size_t>::const_iterator iterator = unnamed_.begin();
+       iterator != unnamed_.end(); ++iterator) {
+    const FunctionStatistics *fn_stats =
+      stats->GetStatisticsById(static_cast<int>(*iterator));
+    StringView name = fn_stats->function()->name();
+    if (name.empty()) {
+      unnamed.push_back(*iterator);
+    } else {
+      WriteName(*iterator, name);
+    }
+  }
+  unnamed_.swap(unnamed);
+}
+
+void TraceRecorder::WriteName(std::size_t id, StringView name) {
+  // The ID and the name length.
+  if (buffer_.size() - size_ < kMaxEventSize) {
+    Flush();
+  }
+  WriteVarint((static_cast<uint64_t>(id) << 2) | NAME);
+  WriteVarint(name.size());
+  Write(name.data(), name.size());
+}
+
+void TraceRecorder::Write(const void *data, std::size_t size) {
+  const char *bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    if (size_ == buffer_.size()) {
+      Flush();
+    }
+    std::size_t chunk = buffer_.size() - size_;
+    if (chunk > size) {
+      chunk = size;
+    }
+    std::memcpy(&buffer_[size_], bytes, chunk);
+    size_ += chunk;
+    bytes += chunk;
+    size -= chunk;
+  }
+}
+
+} // namespace amxprof
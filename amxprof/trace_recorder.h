@@ -0,0 +1,156 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_TRACE_RECORDER_H
+#define AMXPROF_TRACE_RECORDER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "clock.h"
+#include "function_statistics.h"
+#include "macros.h"
+#include "stdint.h"
+#include "string_table.h"
+
+namespace amxprof {
+
+class Statistics;
+
+// TraceRecorder streams the beginning and the end of every call to a
+// binary file through a fixed-size buffer. The file format is:
+//
+//   header:  "AMXTRACE"     magic
+//            uint32         format version (kVersion)
+//            float64        nanoseconds per clock tick
+//   records: varint         (function ID << 2) | record type
+//     BEGIN, END:
+//            varint         zigzag-encoded ticks since the previous event
+//                           (since 0 for the first one)
+//     FUNCTION:
+//            uint8          function type (Function::Type)
+//            varint         name length
+//            char[]         name
+//     NAME:
+//            varint         name length
+//            char[]         name
+//
+// All numbers are little-endian and varints are unsigned LEB128. Function
+// IDs are those of FunctionStatistics::id(); each function is described by
+// a FUNCTION record before its first call, so the name table is built up
+// as new functions are called and a trace can be read even if it was cut
+// short. Names of normal functions are not known at that point yet, they
+// are recorded later in NAME records (see Profiler::ResolveNames()).
+class TraceRecorder {
+ public:
+  static const int kVersion = 2;
+  static const std::size_t kDefaultBufferSize = 1 << 20;
+
+  enum RecordType {
+    BEGIN,
+    END,
+    FUNCTION,
+    NAME
+  };
+
+  // Throws a SystemError if the file can't be opened.
+  explicit TraceRecorder(const std::string &filename,
+                         std::size_t buffer_size = kDefaultBufferSize);
+  ~TraceRecorder();
+
+  void RecordBegin(const FunctionStatistics *fn_stats, TimePoint time) {
+    RecordEvent(BEGIN, fn_stats, time);
+  }
+  void RecordEnd(const FunctionStatistics *fn_stats, TimePoint time) {
+    RecordEvent(END, fn_stats, time);
+  }
+
+  // Records the names of functions that were described without one and
+  // have a name now. stats are the statistics the recorded functions come
+  // from.
+  void RecordNames(const Statistics *stats);
+
+  // Writes out buffered records.
+  void Flush();
+
+  // Returns true if writing to the file failed. Nothing is recorded after
+  // an error.
+  bool has_error() const { return has_error_; }
+
+  unsigned long num_events() const { return num_events_; }
+
+ private:
+  // A BEGIN or END record takes at most this many bytes.
+  static const std::size_t kMaxEventSize = 2 * 10;
+
+  void RecordEvent(RecordType type, const FunctionStatistics *fn_stats,
+                   TimePoint time) {
+    if (has_error_ || fn_stats->id() < 0) {
+      return;
+    }
+    std::size_t id = static_cast<std::size_t>(fn_stats->id());
+    if (id >= defined_.size() || !defined_[id]) {
+      DefineFunction(fn_stats);
+    }
+    if (buffer_.size() - size_ < kMaxEventSize) {
+      Flush();
+    }
+    int64_t delta = time.ticks() - last_time_;
+    last_time_ = time.ticks();
+    WriteVarint((static_cast<uint64_t>(id) << 2) | type);
+    WriteVarint((static_cast<uint64_t>(delta) << 1)
+                ^ static_cast<uint64_t>(delta >> 63));
+    num_events_++;
+  }
+
+  void WriteVarint(uint64_t value) {
+    while (value >= 0x80) {
+      buffer_[size_++] = static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    buffer_[size_++] = static_cast<char>(value);
+  }
+
+  void DefineFunction(const FunctionStatistics *fn_stats);
+  void WriteName(std::size_t id, StringView name);
+  void Write(const void *data, std::size_t size);
+
+ private:
+  std::FILE *file_;
+  std::vector<char> buffer_;
+  std::size_t size_;
+  Ticks last_time_;
+  unsigned long num_events_;
+  bool has_error_;
+  std::vector<bool> defined_;
+  std::vector<std::size_t> unnamed_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TraceRecorder);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_TRACE_RECORDER_H
@@ -0,0 +1,91 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures how fast TraceRecorder encodes and writes out events. Calls are
+// spread over a few hundred functions with a few microseconds between
+// events, roughly what a busy script produces.
+
+#include <cstdio>
+#include <vector>
+#include "clock.h"
+#include "duration.h"
+#include "function.h"
+#include "function_statistics.h"
+#include "trace_recorder.h"
+
+using namespace amxprof;
+
+namespace {
+
+const int kNumFunctions = 256;
+const long kNumCalls = 10000000;
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  const char *filename = (argc > 1) ? argv[1] : "trace_recorder_bench.bin";
+
+  std::vector<Function*> functions;
+  std::vector<FunctionStatistics*> fn_stats;
+  for (int i = 0; i < kNumFunctions; i++) {
+    functions.push_back(Function::Normal(i * 4));
+    fn_stats.push_back(new FunctionStatistics(functions.back(), i));
+  }
+
+  unsigned long random = 1;
+  Ticks time = 0;
+  TimePoint start = Clock::Now();
+  {
+    TraceRecorder recorder(filename);
+    for (long i = 0; i < kNumCalls; i++) {
+      random = random * 1103515245 + 12345;
+      const FunctionStatistics *callee = fn_stats[(random >> 16) % kNumFunctions];
+      time += static_cast<Ticks>((random >> 8) % 4096);
+      recorder.RecordBegin(callee, TimePoint(time));
+      time += static_cast<Ticks>((random >> 4) % 4096);
+      recorder.RecordEnd(callee, TimePoint(time));
+    }
+    recorder.Flush();
+  }
+  double seconds = Clock::ToNanoseconds(Clock::Now() - start).count() / 1e9;
+
+  long size = 0;
+  if (std::FILE *file = std::fopen(filename, "rb")) {
+    std::fseek(file, 0, SEEK_END);
+    size = std::ftell(file);
+    std::fclose(file);
+  }
+  std::remove(filename);
+
+  long num_events = 2 * kNumCalls;
+  std::printf("%ld events in %.3f s: %.1fM events/s, %.2f bytes/event\n",
+              num_events, seconds, num_events / seconds / 1e6,
+              static_cast<double>(size) / num_events);
+
+  for (int i = 0; i < kNumFunctions; i++) {
+    delete fn_stats[i];
+    delete functions[i];
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include "trace_reader.h"
+#include "trace_writer_collapsed.h"
+
+namespace amxprof {
+
+void TraceWriterCollapsed::Write(TraceReader *reader) {
+  std::vector<Frame> stack;
+  TraceReader::Event event;
+
+  while (reader->ReadEvent(event)) {
+    if (event.type == TraceRecorder::BEGIN) {
+      std::size_t parent = stack.empty() ? kNoParent : stack.back().node;
+      Frame frame = {GetNode(parent, event.function_id), event.time, 0};
+      stack.push_back(frame);
+    } else {
+      if (stack.empty()) {
+        continue;
+      }
+      Frame frame = stack.back();
+      stack.pop_back();
+      Ticks total_time = event.time - frame.start_time;
+      nodes_[frame.node].self_time += total_time - frame.child_time;
+      if (!stack.empty()) {
+        stack.back().child_time += total_time;
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < nodes_.size(); i++) {
+    double self_time = static_cast<double>(nodes_[i].self_time)
+                     * reader->ns_per_tick();
+    if (self_time < 0.5) {
+      continue;
+    }
+    WritePath(reader, i);
+    *stream() << ' ' << static_cast<long long>(std::floor(self_time + 0.5))
+              << '\n';
+  }
+}
+
+std::size_t TraceWriterCollapsed::GetNode(std::size_t parent,
+                                          int function_id) {
+  std::pair<NodeIndex::iterator, bool> result = node_index_.insert(
+    std::make_pair(std::make_pair(parent, function_id), nodes_.size()));
+  if (result.second) {
+    Node node = {parent, function_id, 0};
+    nodes_.push_back(node);
+  }
+  return result.first->second;
+}
+
+void TraceWriterCollapsed::WritePath(TraceReader *reader, std::size_t node) {
+  std::vector<int> path;
+  for (; node != kNoParent; node = nodes_[node].parent) {
+    path.push_back(nodes_[node].function_id);
+  }
+  for (std::vector<int>::reverse_iterator iterator = path.rbegin();
+       iterator != path.rend(); ++iterator) {
+    if (iterator != path.rbegin()) {
+      *stream() << ';';
+    }
+    *stream() << GetName(reader, *iterator);
+  }
+}
+
+const std::string &TraceWriterCollapsed::GetName(TraceReader *reader,
+                                                 int id) {
+  std::size_t index = static_cast<std::size_t>(id);
+  if (index >= names_.size()) {
+    names_.resize(index + 1);
+  }
+  if (names_[index].empty()) {
+    const TraceReader::FunctionInfo *info = reader->GetFunction(id);
+    if (info != 0 && !info->name.empty()) {
+      names_[index] = info->name;
+    } else {
+      std::stringstream name;
+      name << "function#" << id;
+      names_[index] = name.str();
+    }
+  }
+  return names_[index];
+}
+
+} // namespace amxprof
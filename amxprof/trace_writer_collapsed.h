@@ -0,0 +1,81 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_TRACE_WRITER_COLLAPSED_H
+#define AMXPROF_TRACE_WRITER_COLLAPSED_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "clock.h"
+#include "trace_writer.h"
+
+namespace amxprof {
+
+// Writes a trace in the collapsed stack format read by flamegraph.pl and
+// similar tools: one line per unique call path with the functions separated
+// by semicolons, followed by the self time of the path in nanoseconds:
+//
+//   OnPlayerUpdate;UpdateHud;format 1234
+//
+// Only the call paths are kept in memory, not the events themselves.
+class TraceWriterCollapsed : public TraceWriter {
+ public:
+  virtual void Write(TraceReader *reader);
+
+ private:
+  struct Node {
+    std::size_t parent;
+    int function_id;
+    Ticks self_time;
+  };
+
+  struct Frame {
+    std::size_t node;
+    Ticks start_time;
+    Ticks child_time;
+  };
+
+  static const std::size_t kNoParent = static_cast<std::size_t>(-1);
+
+  // Returns the index of the node for a call from parent, creating it if
+  // this path was not seen before.
+  std::size_t GetNode(std::size_t parent, int function_id);
+
+  void WritePath(TraceReader *reader, std::size_t node);
+  const std::string &GetName(TraceReader *reader, int id);
+
+ private:
+  typedef std::map<std::pair<std::size_t, int>, std::size_t> NodeIndex;
+
+  std::vector<Node> nodes_;
+  NodeIndex node_index_;
+  std::vector<std::string> names_;
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_TRACE_WRITER_COLLAPSED_H
@@ -0,0 +1,106 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "json_utils.h"
+#include "trace_reader.h"
+#include "trace_writer_json.h"
+
+namespace amxprof {
+
+void TraceWriterJson::Write(TraceReader *reader) {
+  std::ostream::fmtflags flags = stream()->flags();
+  std::streamsize precision = stream()->precision();
+
+  *stream()
+    << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n"
+    << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+    << "\"args\": {\"name\": \"" << EscapeJsonString(script_name()) << "\"}},\n"
+    << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+    << "\"args\": {\"name\": \"Server\"}}";
+
+  // Timestamps are in microseconds, relative to the first event.
+  *stream() << std::fixed << std::setprecision(3);
+
+  TraceReader::Event event;
+  bool is_first = true;
+  Ticks start_time = 0;
+
+  while (reader->ReadEvent(event)) {
+    if (is_first) {
+      start_time = event.time;
+      is_first = false;
+    }
+    double ts = static_cast<double>(event.time - start_time)
+              * reader->ns_per_tick() / 1000.0;
+    *stream()
+      << ",\n{\"name\": \"" << GetName(reader, event.function_id)
+      << "\", \"cat\": \"" << GetCategory(reader, event.function_id)
+      << "\", \"ph\": \"" << (event.type == TraceRecorder::BEGIN ? "B" : "E")
+      << "\", \"pid\": 1, \"tid\": 1, \"ts\": " << ts << "}";
+  }
+
+  *stream() << "\n]}\n";
+
+  stream()->flags(flags);
+  stream()->precision(precision);
+}
+
+const std::string &TraceWriterJson::GetName(TraceReader *reader, int id) {
+  std::size_t index = static_cast<std::size_t>(id);
+  if (index >= names_.size()) {
+    names_.resize(index + 1);
+  }
+  if (names_[index].empty()) {
+    const TraceReader::FunctionInfo *info = reader->GetFunction(id);
+    if (info != 0 && !info->name.empty()) {
+      names_[index] = EscapeJsonString(info->name);
+    } else {
+      std::stringstream name;
+      name << "function#" << id;
+      names_[index] = name.str();
+    }
+  }
+  return names_[index];
+}
+
+const char *TraceWriterJson::GetCategory(TraceReader *reader, int id) {
+  const TraceReader::FunctionInfo *info = reader->GetFunction(id);
+  if (info == 0) {
+    return "unknown";
+  }
+  switch (info->type) {
+    case Function::NORMAL:
+      return "normal";
+    case Function::PUBLIC:
+      return "public";
+    case Function::NATIVE:
+      return "native";
+  }
+  return "unknown";
+}
+
+} // namespace amxprof
@@ -0,0 +1,53 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_TRACE_WRITER_JSON_H
+#define AMXPROF_TRACE_WRITER_JSON_H
+
+#include <string>
+#include <vector>
+#include "trace_writer.h"
+
+namespace amxprof {
+
+// Writes a trace in the Trace Event Format used by chrome://tracing and
+// Perfetto: each call becomes a pair of "B" and "E" events on a single
+// thread. Events are written as they are read, so the output can be much
+// larger than the available memory.
+class TraceWriterJson : public TraceWriter {
+ public:
+  virtual void Write(TraceReader *reader);
+
+ private:
+  // Returns the function's escaped name and category.
+  const std::string &GetName(TraceReader *reader, int id);
+  const char *GetCategory(TraceReader *reader, int id);
+
+ private:
+  std::vector<std::string> names_;
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_TRACE_WRITER_JSON_H
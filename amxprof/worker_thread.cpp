@@ -0,0 +1,120 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "worker_thread.h"
+
+namespace amxprof {
+
+WorkerThread::WorkerThread()
+ : thread_(Main, this),
+   busy_(false),
+   stopping_(false)
+{
+}
+
+WorkerThread::~WorkerThread() {
+  Stop();
+}
+
+void WorkerThread::Start() {
+  stopping_ = false;
+  thread_.Start();
+}
+
+void WorkerThread::Stop() {
+  if (!thread_.is_running()) {
+    return;
+  }
+  {
+    Mutex::ScopedLock lock(&mutex_);
+    stopping_ = true;
+  }
+  task_posted_.Set();
+  thread_.Join();
+}
+
+void WorkerThread::Post(Task *task) {
+  if (!thread_.is_running()) {
+    task->Run();
+    delete task;
+    return;
+  }
+  {
+    Mutex::ScopedLock lock(&mutex_);
+    tasks_.push_back(task);
+  }
+  task_posted_.Set();
+}
+
+void WorkerThread::Flush() {
+  if (!thread_.is_running()) {
+    return;
+  }
+  while (true) {
+    {
+      Mutex::ScopedLock lock(&mutex_);
+      if (tasks_.empty() && !busy_) {
+        return;
+      }
+    }
+    task_finished_.Wait();
+  }
+}
+
+// static
+void WorkerThread::Main(void *arg) {
+  static_cast<WorkerThread*>(arg)->RunTasks();
+}
+
+void WorkerThread::RunTasks() {
+  while (true) {
+    Task *task = 0;
+    {
+      Mutex::ScopedLock lock(&mutex_);
+      if (!tasks_.empty()) {
+        task = tasks_.front();
+        tasks_.pop_front();
+        busy_ = true;
+      } else if (stopping_) {
+        break;
+      }
+    }
+
+    if (task == 0) {
+      task_posted_.Wait();
+      continue;
+    }
+
+    task->Run();
+    delete task;
+
+    {
+      Mutex::ScopedLock lock(&mutex_);
+      busy_ = false;
+    }
+    task_finished_.Set();
+  }
+}
+
+} // namespace amxprof
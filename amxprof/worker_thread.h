@@ -0,0 +1,82 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef AMXPROF_WORKER_THREAD_H
+#define AMXPROF_WORKER_THREAD_H
+
+#include <deque>
+#include "macros.h"
+#include "thread.h"
+
+namespace amxprof {
+
+// WorkerThread runs tasks in a background thread, one at a time and in
+// the order they were posted. It's used to take slow work such as writing
+// reports off the server thread.
+class WorkerThread {
+ public:
+  class Task {
+   public:
+    virtual ~Task() {}
+    // Must not throw.
+    virtual void Run() = 0;
+  };
+
+  WorkerThread();
+  ~WorkerThread();
+
+  // Start() throws a SystemError if the thread can't be created. Stop()
+  // runs all remaining tasks before the thread exits.
+  void Start();
+  void Stop();
+
+  bool is_running() const { return thread_.is_running(); }
+
+  // Queues a task and takes ownership of it. If the thread is not running
+  // the task is run immediately in the calling thread.
+  void Post(Task *task);
+
+  // Blocks until all posted tasks are finished.
+  void Flush();
+
+ private:
+  static void Main(void *arg);
+  void RunTasks();
+
+ private:
+  Thread thread_;
+  Mutex mutex_;
+  Event task_posted_;
+  Event task_finished_;
+  std::deque<Task*> tasks_;
+  bool busy_;
+  bool stopping_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WorkerThread);
+};
+
+} // namespace amxprof
+
+#endif // !AMXPROF_WORKER_THREAD_H
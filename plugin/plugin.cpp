@@ -23,27 +23,41 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <algorithm>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <exception>
 #include <fstream>
 #include <list>
-#include <map>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <subhook.h>
 #include <amx/amx.h>
+#include <amxprof/call_graph_writer_collapsed.h>
 #include <amxprof/call_graph_writer_dot.h>
+#include <amxprof/call_graph_writer_json.h>
+#include <amxprof/clock.h>
+#include <amxprof/code_patcher.h>
 #include <amxprof/debug_info.h>
+#include <amxprof/line_statistics_writer.h>
 #include <amxprof/statistics_writer_html.h>
 #include <amxprof/statistics_writer_text.h>
 #include <amxprof/statistics_writer_json.h>
 #include <amxprof/profiler.h>
+#include <amxprof/thread.h>
+#include <amxprof/trace_reader.h>
+#include <amxprof/trace_recorder.h>
+#include <amxprof/trace_writer_collapsed.h>
+#include <amxprof/trace_writer_json.h>
+#include <amxprof/worker_thread.h>
 #include "amxpath.h"
 #include "configreader.h"
 #include "plugin.h"
 #include "pluginversion.h"
+#include "trampoline.h"
 
 typedef void (*logprintf_t)(const char *format, ...);
 
@@ -51,14 +65,66 @@ extern void *pAMXFunctions;
 
 static logprintf_t logprintf;
 
-typedef std::map<AMX*, AMX_DEBUG> AmxToAmxDebugMap;
-static AmxToAmxDebugMap old_debug_hooks;
+// Everything the plugin keeps for a profiled script. It's attached to the
+// AMX as user data so that the hooks can get to it without a map lookup.
+struct AmxContext {
+  AmxContext()
+   : amx(0),
+     profiler(0),
+     debug_info(0),
+     prev_debug(0),
+     last_snapshot(0),
+     snapshot_stats(0),
+     snapshot_call_graph(0),
+     writing_snapshot(false),
+     trace_recorder(0) {}
+  ~AmxContext() {
+    delete snapshot_call_graph;
+    delete snapshot_stats;
+    delete profiler;
+    delete trace_recorder;
+    delete debug_info;
+  }
 
-typedef std::map<AMX*, amxprof::Profiler*> AmxToProfilerMap;
-static AmxToProfilerMap profilers;
+  AMX *amx;
+  std::string amx_path;
+  amxprof::Profiler *profiler;
+  amxprof::DebugInfo *debug_info;
+  AMX_DEBUG prev_debug;
+  std::time_t last_snapshot;
+
+  // Copies of the profiler's statistics and call graph that are written
+  // by the writer thread. They are only touched by the server thread
+  // while writing_snapshot is false.
+  amxprof::Statistics *snapshot_stats;
+  amxprof::CallGraph *snapshot_call_graph;
+  volatile bool writing_snapshot;
+
+  amxprof::TraceRecorder *trace_recorder;
+};
+
+// All contexts, for periodic snapshots.
+typedef std::list<AmxContext*> AmxContextList;
+static AmxContextList contexts;
+
+static const long kAmxContextTag = AMX_USERTAG('P', 'R', 'O', 'F');
+
+static AmxContext *GetAmxContext(AMX *amx) {
+  for (int i = 0; i < AMX_USERNUM; i++) {
+    if (amx->usertags[i] == kAmxContextTag) {
+      return static_cast<AmxContext*>(amx->userdata[i]);
+    }
+  }
+  return 0;
+}
 
-typedef std::map<AMX*, amxprof::DebugInfo*> AmxToDebugInfoMap; 
-static AmxToDebugInfoMap debug_infos;
+static amxprof::Profiler *GetProfiler(AMX *amx) {
+  AmxContext *context = GetAmxContext(amx);
+  return (context != 0) ? context->profiler : 0;
+}
+
+// Sampling interval in microseconds used unless a valid one is set.
+const int kDefaultSamplingInterval = 1000;
 
 // Plugin settings and their defauls.
 namespace cfg {
@@ -67,67 +133,143 @@ namespace cfg {
   std::string   profile_format        = "html";
   bool          call_graph            = false;
   std::string   call_graph_format     = "dot";
+  int           profile_max_depth     = amxprof::CallStack::kDefaultMaxDepth;
+  std::string   profile_clock         = "monotonic";
+  std::string   profile_mode          = "full";
+  int           profile_sampling_interval = kDefaultSamplingInterval;
+  int           profile_interval      = 0;
+  bool          profile_strip_breaks  = false;
+  bool          profile_async         = false;
+  bool          profile_trace         = false;
+  std::string   profile_trace_format  = "bin";
+  bool          profile_lines         = false;
 }
 
 static void PrintException(const std::exception &e) {
   logprintf("[profiler] Error: %s", e.what());
 }
 
+// Writes snapshots in the background so that the server thread only has
+// to copy the statistics.
+static amxprof::WorkerThread writer_thread;
+
+// logprintf() is not thread-safe, so messages from the writer thread are
+// queued and printed by the server thread on the next tick.
+static amxprof::Mutex deferred_messages_mutex;
+static std::vector<std::string> deferred_messages;
+
+static void DeferredLogprintf(const char *format, ...) {
+  char message[1024];
+  std::va_list args;
+  va_start(args, format);
+  #if defined _MSC_VER
+    _vsnprintf(message, sizeof(message), format, args);
+    message[sizeof(message) - 1] = '\0';
+  #else
+    vsnprintf(message, sizeof(message), format, args);
+  #endif
+  va_end(args);
+
+  amxprof::Mutex::ScopedLock lock(&deferred_messages_mutex);
+  deferred_messages.push_back(message);
+}
+
+static void PrintDeferredMessages() {
+  std::vector<std::string> messages;
+  {
+    amxprof::Mutex::ScopedLock lock(&deferred_messages_mutex);
+    messages.swap(deferred_messages);
+  }
+  for (std::vector<std::string>::const_iterator iterator = messages.begin();
+       iterator != messages.end(); ++iterator) {
+    logprintf("%s", iterator->c_str());
+  }
+}
+
 namespace hooks {
 
 SubHook amx_Exec_hook;
 SubHook amx_Callback_hook;
 
+// Trampolines to the original amx_Exec() and amx_Callback(). They let the
+// hooks stay installed all the time; without them each hook has to remove
+// itself for the duration of the call, which means rewriting code and
+// changing page protection twice per call.
+Trampoline amx_Exec_trampoline_code;
+Trampoline amx_Callback_trampoline_code;
+amxprof::AMX_EXEC amx_Exec_trampoline;
+AMX_CALLBACK amx_Callback_trampoline;
+
+static bool HaveTrampolines() {
+  return amx_Exec_trampoline != 0 && amx_Callback_trampoline != 0;
+}
+
 int AMXAPI amx_Debug(AMX *amx) {
-  amxprof::Profiler *profiler = ::profilers[amx];
-  if (profiler) {
+  AmxContext *context = GetAmxContext(amx);
+  if (context == 0) {
+    return AMX_ERR_NONE;
+  }
+
+  try {
+    context->profiler->DebugHook();
+  } catch (const std::exception &e) {
+    PrintException(e);
+  }
+
+  if (context->prev_debug != 0) {
+    return context->prev_debug(amx);
+  }
+
+  return AMX_ERR_NONE;
+}
+
+static int Callback(AMX *amx, cell index, cell *result, cell *params,
+                    AMX_CALLBACK callback) {
+  amxprof::Profiler *profiler = GetProfiler(amx);
+  if (profiler != 0) {
     try {
-      profiler->DebugHook();
+      return profiler->CallbackHook(index, result, params, callback);
     } catch (const std::exception &e) {
       PrintException(e);
     }
   }
 
-  AmxToAmxDebugMap::const_iterator iterator = old_debug_hooks.find(amx);
-  if (iterator != old_debug_hooks.end()) {
-    if (iterator->second != 0) {
-      return (iterator->second)(amx);
-    }
-  }
-
-  return AMX_ERR_NONE;
+  return callback(amx, index, result, params);
 }
 
 int AMXAPI amx_Callback(AMX *amx, cell index, cell *result, cell *params) {
+  if (HaveTrampolines()) {
+    return Callback(amx, index, result, params, amx_Callback_trampoline);
+  }
+
   SubHook::ScopedRemove r(&amx_Callback_hook);
   SubHook::ScopedInstall i(&amx_Exec_hook);
 
-  amxprof::Profiler *profiler = ::profilers[amx];
+  return Callback(amx, index, result, params, ::amx_Callback);
+}
+
+static int Exec(AMX *amx, cell *retval, int index, amxprof::AMX_EXEC exec) {
+  amxprof::Profiler *profiler = GetProfiler(amx);
   if (profiler != 0) {
     try {
-      return profiler->CallbackHook(index, result, params);
+      return profiler->ExecHook(retval, index, exec);
     } catch (const std::exception &e) {
       PrintException(e);
     }
   }
 
-  return ::amx_Callback(amx, index, result, params);
+  return exec(amx, retval, index);
 }
 
 int AMXAPI amx_Exec(AMX *amx, cell *retval, int index) {
+  if (HaveTrampolines()) {
+    return Exec(amx, retval, index, amx_Exec_trampoline);
+  }
+
   SubHook::ScopedRemove r(&amx_Exec_hook);
   SubHook::ScopedInstall i(&amx_Callback_hook);
 
-  amxprof::Profiler *profiler = ::profilers[amx];
-  if (profiler != 0) {
-    try {
-      return profiler->ExecHook(retval, index);
-    } catch (const std::exception &e) {
-      PrintException(e);
-    }
-  }
-
-  return ::amx_Exec(amx, retval, index);
+  return Exec(amx, retval, index, ::amx_Exec);
 }
 
 } // namespace hooks
@@ -181,15 +323,6 @@ static bool WantsProfiler(const std::string &amx_name) {
   return false;
 }
 
-template<typename Map, typename Key>
-static void DeleteMapEntry(Map &map, const Key &key) {
-  typename Map::iterator iterator = map.find(key);
-  if (iterator != map.end()) {
-    delete iterator->second;
-    map.erase(iterator);
-  }
-}
-
 template<typename Func>
 static void *FunctionToVoidPtr(Func func) {
   return (void*)func;
@@ -199,8 +332,324 @@ static void *AMXAPI amx_Align_stub(void *v) {
   return v;
 }
 
+// Returns the script's path without the extension, output files are named
+// after it.
+static std::string GetAmxBaseName(const std::string &amx_path) {
+  return std::string(amx_path, 0, amx_path.find_last_of("."));
+}
+
+// Number of previous snapshots kept when profile_interval is set.
+static const int kNumOldSnapshots = 3;
+
+// Returns <base>.<extension> for index 0 and <base>.<index>.<extension>
+// for older snapshots.
+static std::string GetOutputFilename(const std::string &base,
+                                     const std::string &extension,
+                                     int index) {
+  std::stringstream filename;
+  filename << base;
+  if (index > 0) {
+    filename << "." << index;
+  }
+  filename << "." << extension;
+  return filename.str();
+}
+
+// Replaces <base>.<extension> with a completely written temporary file.
+// If snapshots are enabled the previous files are rotated first.
+static void CommitOutputFile(const std::string &temp_filename,
+                             const std::string &base,
+                             const std::string &extension) {
+  if (cfg::profile_interval > 0) {
+    std::remove(GetOutputFilename(base, extension, kNumOldSnapshots).c_str());
+    for (int i = kNumOldSnapshots - 1; i >= 0; i--) {
+      std::rename(GetOutputFilename(base, extension, i).c_str(),
+                  GetOutputFilename(base, extension, i + 1).c_str());
+    }
+  } else {
+    std::remove(GetOutputFilename(base, extension, 0).c_str());
+  }
+  std::rename(temp_filename.c_str(),
+              GetOutputFilename(base, extension, 0).c_str());
+}
+
+// Writes the profile and the call graph (if not null) of a script. This is
+// also called from the writer thread, so it must only print messages
+// through log.
+static void WriteProfile(const std::string &amx_path,
+                         const amxprof::Statistics *stats,
+                         const amxprof::CallGraph *call_graph,
+                         bool snapshot,
+                         logprintf_t log) {
+  std::string amx_name = GetAmxBaseName(amx_path);
+
+  std::string profile_base = amx_name + "-profile";
+  std::string profile_filename =
+    GetOutputFilename(profile_base, cfg::profile_format, 0);
+  std::string profile_temp_filename = profile_filename + ".tmp";
+  std::ofstream profile_stream(profile_temp_filename.c_str());
+
+  if (profile_stream.is_open()) {
+    amxprof::StatisticsWriter *writer = 0;
+
+    if (cfg::profile_format == "html") {
+      writer = new amxprof::StatisticsWriterHtml;
+    } else if (cfg::profile_format == "txt" ||
+               cfg::profile_format == "text") {
+      writer = new amxprof::StatisticsWriterText;
+    } else if (cfg::profile_format == "json") {
+      writer = new amxprof::StatisticsWriterJson;
+    } else {
+      log("[profiler] Unrecognized profile format '%s'",
+          cfg::profile_format.c_str());
+    }
+
+    if (writer != 0) {
+      if (!snapshot) {
+        log("[profiler] Writing profile to '%s'",
+            profile_filename.c_str());
+      }
+      writer->set_stream(&profile_stream);
+      writer->set_script_name(amx_path);
+      writer->set_print_date(true);
+      writer->set_print_run_time(true);
+      writer->Write(stats);
+      delete writer;
+    }
+
+    profile_stream.close();
+
+    if (writer != 0) {
+      CommitOutputFile(profile_temp_filename, profile_base,
+                       cfg::profile_format);
+    } else {
+      std::remove(profile_temp_filename.c_str());
+    }
+  } else {
+    log("[profiler]: Error opening file '%s'",
+        profile_temp_filename.c_str());
+  }
+
+  if (call_graph != 0) {
+    std::string call_graph_base = amx_name + "-calls";
+    std::string call_graph_filename =
+      GetOutputFilename(call_graph_base, cfg::call_graph_format, 0);
+    std::string call_graph_temp_filename = call_graph_filename + ".tmp";
+    std::ofstream call_graph_stream(call_graph_temp_filename.c_str());
+
+    if (call_graph_stream.is_open()) {
+      amxprof::CallGraphWriter *writer = 0;
+
+      if (cfg::call_graph_format == "dot") {
+        writer = new amxprof::CallGraphWriterDot;
+      } else if (cfg::call_graph_format == "collapsed") {
+        writer = new amxprof::CallGraphWriterCollapsed;
+      } else if (cfg::call_graph_format == "json") {
+        writer = new amxprof::CallGraphWriterJson;
+      } else {
+        log("[profiler] Unrecognized call graph format '%s'",
+            cfg::call_graph_format.c_str());
+      }
+
+      if (writer != 0) {
+        if (!snapshot) {
+          log("[profiler] Writing call graph to '%s'",
+              call_graph_filename.c_str());
+        }
+        writer->set_stream(&call_graph_stream);
+        writer->set_script_name(amx_path);
+        writer->set_root_node_name("SA-MP Server");
+        writer->Write(call_graph);
+        delete writer;
+      }
+
+      call_graph_stream.close();
+
+      if (writer != 0) {
+        CommitOutputFile(call_graph_temp_filename, call_graph_base,
+                         cfg::call_graph_format);
+      } else {
+        std::remove(call_graph_temp_filename.c_str());
+      }
+    } else {
+      log("[profiler]: Error opening file '%s'",
+          call_graph_temp_filename.c_str());
+    }
+  }
+}
+
+// Writes the time spent on each line of a script to <script>-lines.txt.
+static void WriteLineProfile(const std::string &amx_path,
+                             const amxprof::LineStatistics *line_stats,
+                             const amxprof::DebugInfo *debug_info,
+                             logprintf_t log) {
+  std::string filename = GetAmxBaseName(amx_path) + "-lines.txt";
+  std::ofstream stream(filename.c_str());
+
+  if (stream.is_open()) {
+    log("[profiler] Writing line profile to '%s'", filename.c_str());
+    amxprof::LineStatisticsWriter writer;
+    writer.set_stream(&stream);
+    writer.set_script_name(amx_path);
+    writer.set_print_date(true);
+    writer.Write(line_stats, debug_info);
+  } else {
+    log("[profiler]: Error opening file '%s'", filename.c_str());
+  }
+}
+
+// Writes a snapshot made by TakeSnapshot() in the writer thread.
+class WriteSnapshotTask : public amxprof::WorkerThread::Task {
+ public:
+  explicit WriteSnapshotTask(AmxContext *context) : context_(context) {}
+
+  virtual void Run() {
+    try {
+      WriteProfile(context_->amx_path,
+                   context_->snapshot_stats,
+                   context_->snapshot_call_graph,
+                   true,
+                   DeferredLogprintf);
+    } catch (const std::exception &e) {
+      DeferredLogprintf("[profiler] Error: %s", e.what());
+    }
+    COMPILER_BARRIER();
+    context_->writing_snapshot = false;
+  }
+
+ private:
+  AmxContext *context_;
+};
+
+// Writes the profile of an unloaded script in the writer thread and then
+// deletes its context. The profiler must be detached from the AMX.
+class WriteFinalProfileTask : public amxprof::WorkerThread::Task {
+ public:
+  explicit WriteFinalProfileTask(AmxContext *context) : context_(context) {}
+
+  virtual void Run() {
+    amxprof::Profiler *profiler = context_->profiler;
+    try {
+      WriteProfile(context_->amx_path,
+                   profiler->stats(),
+                   profiler->call_graph_enabled() ? profiler->call_graph() : 0,
+                   false,
+                   DeferredLogprintf);
+      if (profiler->is_profiling_lines()) {
+        WriteLineProfile(context_->amx_path,
+                         profiler->line_stats(),
+                         context_->debug_info,
+                         DeferredLogprintf);
+      }
+    } catch (const std::exception &e) {
+      DeferredLogprintf("[profiler] Error: %s", e.what());
+    }
+    delete context_;
+  }
+
+ private:
+  AmxContext *context_;
+};
+
+// Converts a recorded call trace to another format in the writer thread.
+// The binary trace is removed once it has been converted.
+class ConvertTraceTask : public amxprof::WorkerThread::Task {
+ public:
+  ConvertTraceTask(const std::string &amx_path,
+                   const std::string &trace_filename)
+   : amx_path_(amx_path),
+     trace_filename_(trace_filename) {}
+
+  virtual void Run() {
+    std::string base = GetAmxBaseName(amx_path_);
+    std::string output_filename = base + "-trace." + cfg::profile_trace_format;
+
+    amxprof::TraceWriter *writer = 0;
+    if (cfg::profile_trace_format == "json") {
+      writer = new amxprof::TraceWriterJson;
+    } else if (cfg::profile_trace_format == "collapsed") {
+      writer = new amxprof::TraceWriterCollapsed;
+    } else {
+      return;
+    }
+
+    bool converted = false;
+    try {
+      amxprof::TraceReader reader(trace_filename_);
+      std::ofstream stream(output_filename.c_str());
+      if (stream.is_open()) {
+        writer->set_stream(&stream);
+        writer->set_script_name(amx_path_);
+        writer->Write(&reader);
+        converted = true;
+      } else {
+        DeferredLogprintf("[profiler] Error opening file '%s'",
+                          output_filename.c_str());
+      }
+    } catch (const std::exception &e) {
+      DeferredLogprintf("[profiler] Error: %s", e.what());
+    }
+
+    if (converted) {
+      std::remove(trace_filename_.c_str());
+    } else {
+      DeferredLogprintf("[profiler] Binary call trace kept in '%s'",
+                        trace_filename_.c_str());
+    }
+
+    delete writer;
+  }
+
+ private:
+  std::string amx_path_;
+  std::string trace_filename_;
+};
+
+// Gives the finished trace of a script a name of its own, so that it can
+// still be converted after the script is loaded again and starts a new
+// trace. Returns the new name or an empty string on failure.
+static std::string MoveTraceAside(const std::string &amx_path) {
+  static unsigned long num_moved_traces = 0;
+
+  std::string trace_filename = GetAmxBaseName(amx_path) + "-trace.bin";
+  std::stringstream new_filename;
+  new_filename << trace_filename << "." << ++num_moved_traces << ".tmp";
+
+  std::remove(new_filename.str().c_str());
+  if (std::rename(trace_filename.c_str(), new_filename.str().c_str()) != 0) {
+    return std::string();
+  }
+  return new_filename.str();
+}
+
+// Copies the script's statistics and has them written by the writer
+// thread. Snapshots must not be taken in the middle of a call as its time
+// would be missing from stats().
+static void TakeSnapshot(AmxContext *context) {
+  amxprof::Profiler *profiler = context->profiler;
+  const amxprof::Statistics *stats = profiler->stats();
+
+  if (context->snapshot_stats == 0) {
+    context->snapshot_stats = new amxprof::Statistics(stats->num_natives(),
+                                                      stats->num_publics());
+  }
+  stats->CopyTo(context->snapshot_stats);
+
+  if (profiler->call_graph_enabled()) {
+    if (context->snapshot_call_graph == 0) {
+      context->snapshot_call_graph = new amxprof::CallGraph;
+    }
+    profiler->call_graph()->CopyTo(context->snapshot_call_graph,
+                                   context->snapshot_stats);
+  }
+
+  context->writing_snapshot = true;
+  COMPILER_BARRIER();
+  writer_thread.Post(new WriteSnapshotTask(context));
+}
+
 PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports() {
-  return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
+  return SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
 }
 
 PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
@@ -214,6 +663,18 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
     exports[PLUGIN_AMX_EXPORT_Align32] = FunctionToVoidPtr(amx_Align_stub);
     exports[PLUGIN_AMX_EXPORT_Align64] = FunctionToVoidPtr(amx_Align_stub);
 
+    // The trampolines copy the original code, so they must be created
+    // before the hooks overwrite it.
+    if (hooks::amx_Exec_trampoline_code.Create(
+          exports[PLUGIN_AMX_EXPORT_Exec]) &&
+        hooks::amx_Callback_trampoline_code.Create(
+          exports[PLUGIN_AMX_EXPORT_Callback])) {
+      hooks::amx_Exec_trampoline = reinterpret_cast<amxprof::AMX_EXEC>(
+        hooks::amx_Exec_trampoline_code.code());
+      hooks::amx_Callback_trampoline = reinterpret_cast<AMX_CALLBACK>(
+        hooks::amx_Callback_trampoline_code.code());
+    }
+
     hooks::amx_Exec_hook.Install(exports[PLUGIN_AMX_EXPORT_Exec],
                                  FunctionToVoidPtr(hooks::amx_Exec));
     hooks::amx_Callback_hook.Install(exports[PLUGIN_AMX_EXPORT_Callback],
@@ -225,6 +686,69 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void **ppData) {
     server_cfg.GetOption("profile_format", cfg::profile_format);
     server_cfg.GetOption("call_graph", cfg::call_graph);
     server_cfg.GetOption("call_graph_format", cfg::call_graph_format);
+    server_cfg.GetOption("profile_max_depth", cfg::profile_max_depth);
+    server_cfg.GetOption("profile_clock", cfg::profile_clock);
+    server_cfg.GetOption("profile_mode", cfg::profile_mode);
+    server_cfg.GetOption("profile_sampling_interval",
+                         cfg::profile_sampling_interval);
+    server_cfg.GetOption("profile_strip_breaks", cfg::profile_strip_breaks);
+    server_cfg.GetOption("profile_interval", cfg::profile_interval);
+    server_cfg.GetOption("profile_async", cfg::profile_async);
+    server_cfg.GetOption("profile_trace", cfg::profile_trace);
+    server_cfg.GetOption("profile_trace_format", cfg::profile_trace_format);
+    server_cfg.GetOption("profile_lines", cfg::profile_lines);
+
+    ToLower(cfg::profile_clock);
+    if (cfg::profile_clock == "tsc") {
+      if (!amxprof::Clock::SetSource(amxprof::Clock::TSC)) {
+        logprintf("[profiler] TSC is not invariant on this machine, "
+                  "falling back to monotonic clock");
+      }
+    } else if (cfg::profile_clock != "monotonic") {
+      logprintf("[profiler] Unrecognized clock '%s'",
+                cfg::profile_clock.c_str());
+    }
+
+    if (cfg::profile_max_depth <= 0) {
+      logprintf("[profiler] Invalid profile_max_depth %d, using %d",
+                cfg::profile_max_depth,
+                static_cast<int>(amxprof::CallStack::kDefaultMaxDepth));
+      cfg::profile_max_depth = amxprof::CallStack::kDefaultMaxDepth;
+    }
+
+    if (cfg::profile_sampling_interval <= 0) {
+      logprintf("[profiler] Invalid profile_sampling_interval %d, using %d",
+                cfg::profile_sampling_interval, kDefaultSamplingInterval);
+      cfg::profile_sampling_interval = kDefaultSamplingInterval;
+    }
+
+    ToLower(cfg::profile_format);
+    ToLower(cfg::call_graph_format);
+
+    ToLower(cfg::profile_mode);
+    if (cfg::profile_mode != "full" &&
+        cfg::profile_mode != "publics" &&
+        cfg::profile_mode != "sampling") {
+      logprintf("[profiler] Unrecognized profile mode '%s'",
+                cfg::profile_mode.c_str());
+      cfg::profile_mode = "full";
+    }
+
+    ToLower(cfg::profile_trace_format);
+    if (cfg::profile_trace_format != "bin" &&
+        cfg::profile_trace_format != "json" &&
+        cfg::profile_trace_format != "collapsed") {
+      logprintf("[profiler] Unrecognized trace format '%s'",
+                cfg::profile_trace_format.c_str());
+      cfg::profile_trace_format = "bin";
+    }
+
+    try {
+      writer_thread.Start();
+    } catch (const std::exception &e) {
+      PrintException(e);
+      logprintf("[profiler] Output will be written on the server thread");
+    }
 
     logprintf("  Profiler v" PROJECT_VERSION_STRING " is OK.");
   }
@@ -248,13 +772,14 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
       return AMX_ERR_NONE;
     }
 
+    // Publics and natives are identified by their table entries, so debug
+    // info is only needed when normal functions are profiled too.
+    bool publics_only = (cfg::profile_mode == "publics");
     amxprof::DebugInfo *debug_info = 0;
 
-    if (amxprof::HasDebugInfo(amx)) {
+    if (!publics_only && amxprof::HasDebugInfo(amx)) {
       debug_info = new amxprof::DebugInfo(filename);
-      if (debug_info->is_loaded()) {
-        ::debug_infos[amx] = debug_info;
-      } else {
+      if (!debug_info->is_loaded()) {
         logprintf("[profiler] Error loading debug info: %s",
                   aux_StrError(debug_info->last_error()));
         delete debug_info;
@@ -262,21 +787,105 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
       }
     }
 
-    amxprof::Profiler *profiler = new amxprof::Profiler(amx,
-                                                                  debug_info);
+    amxprof::Profiler *profiler = new amxprof::Profiler(amx, debug_info,
+                                                        cfg::profile_max_depth);
     profiler->set_call_graph_enabled(cfg::call_graph);
 
-    if (debug_info != 0) {
+    if (cfg::profile_mode == "sampling") {
+      try {
+        profiler->StartSampling(amxprof::Microseconds(
+          cfg::profile_sampling_interval));
+      } catch (const std::exception &e) {
+        PrintException(e);
+        logprintf("[profiler] Falling back to full profile mode");
+      }
+    }
+    if (cfg::profile_async && !profiler->is_sampling()) {
+      try {
+        profiler->StartAsync();
+      } catch (const std::exception &e) {
+        PrintException(e);
+        logprintf("[profiler] Statistics will be collected on the server "
+                  "thread");
+      }
+    }
+    if (!profiler->is_sampling()) {
+      profiler->Calibrate();
+    }
+
+    if (cfg::profile_lines) {
+      if (publics_only) {
+        logprintf("[profiler] Lines are not profiled in publics mode");
+      } else if (debug_info == 0) {
+        logprintf("[profiler] Lines can't be profiled without debug info");
+      } else {
+        try {
+          profiler->StartLineProfiling();
+        } catch (const std::exception &e) {
+          PrintException(e);
+        }
+      }
+    }
+
+    AmxContext *context = new AmxContext;
+    context->amx = amx;
+    context->amx_path = filename;
+    context->profiler = profiler;
+    context->debug_info = debug_info;
+    context->last_snapshot = std::time(0);
+
+    if (amx_SetUserData(amx, kAmxContextTag, context) != AMX_ERR_NONE) {
+      logprintf("[profiler] Can't attach profiler to '%s': no free user "
+                "data slots", filename.c_str());
+      delete context;
+      return AMX_ERR_NONE;
+    }
+
+    ::contexts.push_back(context);
+
+    // Strip only once the profiler is attached, so that a script that isn't
+    // profiled keeps its BREAKs. Line profiling needs every BREAK.
+    if (cfg::profile_strip_breaks && !publics_only &&
+        !profiler->is_sampling() && !profiler->is_profiling_lines()) {
+      try {
+        amxprof::CodePatcher patcher(amx);
+        int num_removed = patcher.RemoveRedundantBreaks();
+        logprintf("[profiler] Removed %d of %d BREAK instructions",
+                  num_removed, patcher.num_breaks());
+      } catch (const std::exception &e) {
+        PrintException(e);
+      }
+    }
+
+    if (cfg::profile_trace && !profiler->is_sampling()) {
+      std::string trace_filename = GetAmxBaseName(filename) + "-trace.bin";
+      try {
+        context->trace_recorder = new amxprof::TraceRecorder(trace_filename);
+        profiler->set_trace_recorder(context->trace_recorder);
+        logprintf("[profiler] Recording call trace to '%s'",
+                  trace_filename.c_str());
+      } catch (const std::exception &e) {
+        PrintException(e);
+      }
+    }
+
+    if (publics_only) {
+      logprintf("[profiler] Attached profiler to '%s' (publics only)",
+                filename.c_str());
+    } else if (debug_info != 0) {
       logprintf("[profiler] Attached profiler to '%s'", filename.c_str());
     } else {
       logprintf("[profiler] Attached profiler to '%s' (no debug info)",
                 filename.c_str());
     }
 
-    ::old_debug_hooks[amx] = amx->debug;
-    amx_SetDebugHook(amx, hooks::amx_Debug);
-
-    ::profilers[amx] = profiler;
+    // Normal functions can only be detected from the debug hook. Leave it
+    // alone if they aren't needed so that running the script code itself
+    // costs nothing extra.
+    if (!publics_only) {
+      context->prev_debug = amx->debug;
+      amx_SetDebugHook(amx, hooks::amx_Debug);
+    }
   }
   catch (const std::exception &e) {
     PrintException(e);
@@ -287,86 +896,66 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX *amx) {
 
 PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx) {
   try {
-    amxprof::Profiler *profiler = ::profilers[amx];
-
-    if (profiler != 0) {
-      std::string amx_path = GetAmxPath(amx);
-      std::string amx_name = std::string(amx_path, 0,
-                                         amx_path.find_last_of("."));
-
-      ToLower(cfg::profile_format);
-      std::string profile_filename = amx_name + "-profile." +
-                                     cfg::profile_format;
-      std::ofstream profile_stream(profile_filename.c_str());
-
-      if (profile_stream.is_open()) {
-        amxprof::StatisticsWriter *writer = 0;
-
-        if (cfg::profile_format == "html") {
-          writer = new amxprof::StatisticsWriterHtml;
-        } else if (cfg::profile_format == "txt" ||
-                   cfg::profile_format == "text") {
-          writer = new amxprof::StatisticsWriterText;
-        } else if (cfg::profile_format == "json") {
-          writer = new amxprof::StatisticsWriterJson;
-        } else {
-          logprintf("[profiler] Unrecognized profile format '%s'",
-                    cfg::profile_format.c_str());
-        }
+    AmxContext *context = GetAmxContext(amx);
 
-        if (writer != 0) {
-          logprintf("[profiler] Writing profile to '%s'",
-                    profile_filename.c_str());
-          writer->set_stream(&profile_stream);
-          writer->set_script_name(amx_path);
-          writer->set_print_date(true);
-          writer->set_print_run_time(true);
-          writer->Write(profiler->stats());
-          delete writer;
-        }
+    if (context != 0) {
+      amxprof::Profiler *profiler = context->profiler;
 
-        profile_stream.close();
-      } else {
-        logprintf("[profiler]: Error opening file '%s'",
-                  profile_filename.c_str());
+      profiler->UpdateStatistics();
+      if (context->trace_recorder != 0) {
+        context->trace_recorder->Flush();
+        if (context->trace_recorder->has_error()) {
+          logprintf("[profiler] Error writing call trace, it is incomplete");
+        }
+      }
+      if (profiler->is_sampling()) {
+        long num_dropped = profiler->sampler()->num_dropped_samples();
+        if (num_dropped > 0) {
+          logprintf("[profiler] Dropped %ld samples, consider increasing "
+                    "profile_sampling_interval", num_dropped);
+        }
+      }
+      if (profiler->num_dropped_calls() > 0) {
+        logprintf("[profiler] %lu calls were deeper than profile_max_depth "
+                  "and were not profiled", profiler->num_dropped_calls());
       }
 
-      if (cfg::call_graph) {
-        ToLower(cfg::call_graph_format);
-        std::string call_graph_filename = amx_name + "-calls." +
-                                          cfg::call_graph_format;
-        std::ofstream call_graph_stream(call_graph_filename.c_str());
-
-        if (call_graph_stream.is_open()) {
-          amxprof::CallGraphWriterDot *writer = 0;
-
-          if (cfg::call_graph_format == "dot") {
-            writer = new amxprof::CallGraphWriterDot;
-          } else {
-            logprintf("[profiler] Unrecognized call graph format '%s'",
-                      cfg::call_graph_format.c_str());
+      // The results no longer change, so the writer thread can have the
+      // whole context. It runs after any snapshot of this script that is
+      // still being written.
+      profiler->Detach();
+      ::contexts.remove(context);
+      amx_SetUserData(amx, kAmxContextTag, 0);
+
+      // Nothing is recorded after Detach(). The trace is closed here rather
+      // than in the writer thread because the script may be loaded again
+      // and reopen the file before the writer thread gets to it.
+      std::string amx_path = context->amx_path;
+      std::string trace_filename;
+      if (context->trace_recorder != 0) {
+        profiler->set_trace_recorder(0);
+        delete context->trace_recorder;
+        context->trace_recorder = 0;
+        if (cfg::profile_trace_format != "bin") {
+          trace_filename = MoveTraceAside(amx_path);
+          if (trace_filename.empty()) {
+            logprintf("[profiler] Can't convert call trace: error renaming "
+                      "'%s'", (GetAmxBaseName(amx_path) +
+                               "-trace.bin").c_str());
           }
+        }
+      }
 
-          if (writer != 0) {
-            logprintf("[profiler] Writing call graph to '%s'",
-                      call_graph_filename.c_str());
-            writer->set_stream(&call_graph_stream);
-            writer->set_script_name(amx_path);
-            writer->set_root_node_name("SA-MP Server");
-            writer->Write(profiler->call_graph());
-            delete writer;
-          }
+      writer_thread.Post(new WriteFinalProfileTask(context));
 
-          call_graph_stream.close();
-        } else {
-          logprintf("[profiler]: Error opening file '%s'",
-                    call_graph_filename.c_str());
-        }
+      if (!trace_filename.empty()) {
+        logprintf("[profiler] Writing call trace to '%s'",
+                  (GetAmxBaseName(amx_path) + "-trace." +
+                   cfg::profile_trace_format).c_str());
+        writer_thread.Post(new ConvertTraceTask(amx_path, trace_filename));
       }
+      PrintDeferredMessages();
     }
-
-    DeleteMapEntry(::profilers, amx);
-    DeleteMapEntry(::debug_infos, amx);
   }
   catch (const std::exception &e) {
     PrintException(e);
@@ -374,3 +963,41 @@ PLUGIN_EXPORT int PLUGIN_CALL AmxUnload(AMX *amx) {
 
   return AMX_ERR_NONE;
 }
+
+PLUGIN_EXPORT void PLUGIN_CALL Unload() {
+  writer_thread.Stop();
+  PrintDeferredMessages();
+}
+
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick() {
+  PrintDeferredMessages();
+
+  if (cfg::profile_interval <= 0) {
+    return;
+  }
+
+  std::time_t now = std::time(0);
+
+  for (AmxContextList::const_iterator iterator = ::contexts.begin();
+       iterator != ::contexts.end(); ++iterator) {
+    AmxContext *context = *iterator;
+    amxprof::Profiler *profiler = context->profiler;
+
+    // If the script is in the middle of something or the previous snapshot
+    // is still being written, try again on the next tick.
+    if (now - context->last_snapshot < cfg::profile_interval
+        || profiler->is_executing()
+        || context->writing_snapshot) {
+      continue;
+    }
+
+    try {
+      profiler->UpdateStatistics();
+      TakeSnapshot(context);
+    } catch (const std::exception &e) {
+      PrintException(e);
+    }
+
+    context->last_snapshot = now;
+  }
+}
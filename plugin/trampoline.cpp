@@ -0,0 +1,200 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "trampoline.h"
+
+namespace {
+
+#if defined _M_X64 || defined __x86_64__
+  #define TRAMPOLINE_X86_64
+#endif
+
+// Size of the jump that SubHook writes over the start of a hooked function.
+const std::size_t kHookJumpSize = 5;
+const std::size_t kMaxInstructionSize = 15;
+
+#ifdef TRAMPOLINE_X86_64
+  // jmp qword ptr [rip + 0] followed by the 64-bit address.
+  const unsigned char kJumpCode[] = {0xFF, 0x25, 0x00, 0x00, 0x00, 0x00};
+  const std::size_t kJumpSize = sizeof(kJumpCode) + sizeof(void*);
+#else
+  // jmp rel32
+  const std::size_t kJumpSize = 5;
+#endif
+
+const std::size_t kTrampolineSize =
+  kHookJumpSize + kMaxInstructionSize - 1 + kJumpSize;
+
+// Returns the length of the ModR/M operand starting at code (the ModR/M
+// byte itself, SIB and displacement) or 0 if it uses RIP-relative
+// addressing, which can't be copied as is.
+std::size_t GetModRMLength(const unsigned char *code) {
+  unsigned char modrm = code[0];
+  unsigned char mod = modrm >> 6;
+  unsigned char rm = modrm & 7;
+  std::size_t length = 1;
+
+  if (mod == 3) {
+    return length;
+  }
+
+  if (rm == 4) {
+    unsigned char sib = code[1];
+    length++;
+    if (mod == 0 && (sib & 7) == 5) {
+      length += 4;
+    }
+  } else if (mod == 0 && rm == 5) {
+    #ifdef TRAMPOLINE_X86_64
+      return 0;
+    #else
+      length += 4;
+    #endif
+  }
+
+  if (mod == 1) {
+    length += 1;
+  } else if (mod == 2) {
+    length += 4;
+  }
+
+  return length;
+}
+
+// Returns the length of the instruction at code or 0 if it's not one of
+// the instructions that can be relocated.
+std::size_t GetInstructionLength(const unsigned char *code) {
+  std::size_t prefix = 0;
+  std::size_t modrm;
+
+  #ifdef TRAMPOLINE_X86_64
+    if ((code[0] & 0xF0) == 0x40) { // REX
+      prefix = 1;
+    }
+  #endif
+
+  unsigned char opcode = code[prefix];
+
+  if (opcode >= 0x50 && opcode <= 0x5F) { // push/pop r
+    return prefix + 1;
+  }
+  #ifndef TRAMPOLINE_X86_64
+    if (opcode >= 0x40 && opcode <= 0x4F) { // inc/dec r
+      return prefix + 1;
+    }
+  #endif
+  if (opcode == 0x90) { // nop
+    return prefix + 1;
+  }
+  if (opcode == 0x6A) { // push imm8
+    return prefix + 2;
+  }
+  if (opcode == 0x68) { // push imm32
+    return prefix + 5;
+  }
+  if (opcode >= 0xB8 && opcode <= 0xBF) { // mov r, imm
+    return prefix + ((prefix != 0 && (code[0] & 8) != 0) ? 9 : 5);
+  }
+
+  switch (opcode) {
+    case 0x01: case 0x03: // add
+    case 0x29: case 0x2B: // sub
+    case 0x31: case 0x33: // xor
+    case 0x39: case 0x3B: // cmp
+    case 0x85:            // test
+    case 0x89: case 0x8B: // mov
+    case 0x8D:            // lea
+      modrm = GetModRMLength(code + prefix + 1);
+      return modrm != 0 ? prefix + 1 + modrm : 0;
+    case 0x83: // add/sub/cmp r/m, imm8
+      modrm = GetModRMLength(code + prefix + 1);
+      return modrm != 0 ? prefix + 1 + modrm + 1 : 0;
+    case 0x81: // add/sub/cmp r/m, imm32
+    case 0xC7: // mov r/m, imm32
+      modrm = GetModRMLength(code + prefix + 1);
+      return modrm != 0 ? prefix + 1 + modrm + 4 : 0;
+  }
+
+  return 0;
+}
+
+} // anonymous namespace
+
+Trampoline::Trampoline()
+ : code_(0)
+{
+}
+
+Trampoline::~Trampoline() {
+  Destroy();
+}
+
+bool Trampoline::Create(void *src) {
+  Destroy();
+
+  const unsigned char *src_code = static_cast<const unsigned char*>(src);
+  std::size_t length = 0;
+
+  while (length < kHookJumpSize) {
+    std::size_t instr_length = GetInstructionLength(src_code + length);
+    if (instr_length == 0) {
+      return false;
+    }
+    length += instr_length;
+  }
+
+  unsigned char *code =
+    static_cast<unsigned char*>(AllocateMemory(kTrampolineSize));
+  if (code == 0) {
+    return false;
+  }
+
+  std::memcpy(code, src_code, length);
+
+  const unsigned char *target = src_code + length;
+  #ifdef TRAMPOLINE_X86_64
+    std::memcpy(code + length, kJumpCode, sizeof(kJumpCode));
+    std::memcpy(code + length + sizeof(kJumpCode), &target, sizeof(target));
+  #else
+    int offset = static_cast<int>(target - (code + length + kJumpSize));
+    code[length] = 0xE9;
+    std::memcpy(code + length + 1, &offset, sizeof(offset));
+  #endif
+
+  if (!MakeExecutable(code, kTrampolineSize)) {
+    FreeMemory(code, kTrampolineSize);
+    return false;
+  }
+
+  code_ = code;
+  return true;
+}
+
+void Trampoline::Destroy() {
+  if (code_ != 0) {
+    FreeMemory(code_, kTrampolineSize);
+    code_ = 0;
+  }
+}
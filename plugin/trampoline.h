@@ -0,0 +1,62 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef TRAMPOLINE_H
+#define TRAMPOLINE_H
+
+#include <cstddef>
+
+// Trampoline runs the original code of a function whose start is going to
+// be overwritten by a hook: the whole instructions covered by the hook's
+// jump are copied to a dedicated executable buffer, followed by a jump to
+// the rest of the function. Only the instructions commonly found in
+// function prologues can be relocated.
+class Trampoline {
+ public:
+  Trampoline();
+  ~Trampoline();
+
+  // Must be called before the hook is installed. Returns false if the code
+  // at src can't be relocated or executable memory can't be allocated.
+  bool Create(void *src);
+  void Destroy();
+
+  // Returns 0 if the trampoline hasn't been created.
+  void *code() const { return code_; }
+
+ private:
+  Trampoline(const Trampoline &);
+  void operator=(const Trampoline &);
+
+  // Platform-specific. The memory is allocated writable and then made
+  // read-only and executable once the code has been written.
+  static void *AllocateMemory(std::size_t size);
+  static bool MakeExecutable(void *memory, std::size_t size);
+  static void FreeMemory(void *memory, std::size_t size);
+
+ private:
+  void *code_;
+};
+
+#endif // !TRAMPOLINE_H
@@ -0,0 +1,109 @@
+// Copyright (c) 2013, Zeex
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the cost of calling a hooked function's original code from the
+// hook, either through a Trampoline or by removing the hook for the
+// duration of the call and installing it again afterwards, which is what
+// the plugin does when no trampoline can be created.
+
+#include <cstdio>
+#include <ctime>
+#include <subhook.h>
+#include "trampoline.h"
+
+#if defined _MSC_VER
+  #define NOINLINE __declspec(noinline)
+#else
+  #define NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+
+const int kNumCalls = 1000000;
+
+typedef int (*Function)(int);
+
+SubHook hook;
+Function trampoline;
+volatile int sink;
+
+NOINLINE int Bar(int x) {
+  sink += x;
+  return sink;
+}
+
+Function volatile bar = Bar;
+
+// Keeps values across indirect calls so that, like amx_Exec(), it starts
+// by saving registers even in optimized builds. A trampoline can only be
+// created for such common prologue instructions.
+NOINLINE int Foo(int x) {
+  int a = bar(x);
+  int b = bar(a);
+  int c = bar(b);
+  int d = bar(c);
+  return x + a + b + c + d;
+}
+
+NOINLINE int FooTrampolineHook(int x) {
+  return trampoline(x);
+}
+
+NOINLINE int FooRemoveInstallHook(int x) {
+  SubHook::ScopedRemove r(&hook);
+  return Foo(x);
+}
+
+double TimeCalls(Function volatile function) {
+  std::clock_t start = std::clock();
+  for (int i = 0; i < kNumCalls; i++) {
+    function(i);
+  }
+  return static_cast<double>(std::clock() - start)
+         / CLOCKS_PER_SEC * 1e9 / kNumCalls;
+}
+
+} // anonymous namespace
+
+int main() {
+  std::printf("unhooked        %8.1f ns/call\n", TimeCalls(Foo));
+
+  Trampoline trampoline_code;
+  if (trampoline_code.Create(reinterpret_cast<void*>(Foo))) {
+    trampoline = reinterpret_cast<Function>(trampoline_code.code());
+    hook.Install(reinterpret_cast<void*>(Foo),
+                 reinterpret_cast<void*>(FooTrampolineHook));
+    std::printf("trampoline      %8.1f ns/call\n", TimeCalls(Foo));
+    hook.Remove();
+  } else {
+    std::printf("trampoline      not available\n");
+  }
+
+  hook.Install(reinterpret_cast<void*>(Foo),
+               reinterpret_cast<void*>(FooRemoveInstallHook));
+  std::printf("remove/install  %8.1f ns/call\n", TimeCalls(Foo));
+  hook.Remove();
+
+  return 0;
+}